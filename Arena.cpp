@@ -0,0 +1,398 @@
+#include "Arena.h"
+#include "MoveGen.h"
+#include "Versus.h"
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <random>
+#include <algorithm>
+
+// value of a placement that tops out
+static const float LOSS = -1e9f;
+
+static_assert(sizeof(ArenaRecord) == 24, "the results file depends on the record layout");
+
+void Arena::AddPlayer(const ArenaPlayer& player)
+{
+	players.push_back(player);
+}
+
+// gamesPerPair new games for every pair of players, the seeds carry on after the games of this mode already in the file
+// the main thread saves finished games and prints progress while the pool plays
+// games run on lane threads of their own, one per pool thread, so the pool only holds search tasks
+// and a search waiting on it helps other searches but never picks up a game
+bool Arena::Run(const string& resultsPath, int mode, int gamesPerPair)
+{
+	if (players.size() < 2)
+		return false;
+	LoadRecords(resultsPath);
+	unsigned int firstSeed = 0;
+	for (const ArenaRecord& record : records)
+		if (record.mode == mode)
+			firstSeed = max(firstSeed, record.seed + 1);
+
+	vector<pair<int, int>> pairs;
+	for (int a = 0; a < (int)players.size(); a++)
+		for (int b = a + 1; b < (int)players.size(); b++)
+			pairs.push_back(make_pair(a, b));
+	int total = (int)pairs.size() * gamesPerPair;
+	printf("%d players, %d games on %d threads, results in %s\n", (int)players.size(), total, pool.Size(), resultsPath.c_str());
+
+	vector<ArenaRecord> results(total);
+	mutex lock;
+	vector<int> finished;
+	atomic<int> nextTask(0);
+	vector<thread> lanes;
+	for (int lane = 0; lane < pool.Size(); lane++)
+		lanes.push_back(thread([&] {
+			for (int task = nextTask++; task < total; task = nextTask++)
+			{
+				const pair<int, int>& match = pairs[task / gamesPerPair];
+				int game = task % gamesPerPair;
+				// the side that moves first in a turn of a garbage game is swapped every game
+				const ArenaPlayer& first = players[game % 2 == 0 ? match.first : match.second];
+				const ArenaPlayer& second = players[game % 2 == 0 ? match.second : match.first];
+				results[task] = Play(first, second, mode, firstSeed + game);
+				lock_guard<mutex> guard(lock);
+				finished.push_back(task);
+			}
+		}));
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	int done = 0;
+	bool saved = true;
+	while (done < total)
+	{
+		this_thread::sleep_for(chrono::milliseconds(PROGRESS_MILLISECOND));
+		vector<int> batch;
+		{
+			lock_guard<mutex> guard(lock);
+			batch.swap(finished);
+		}
+		// the whole batch goes to the file in one write
+		vector<ArenaRecord> newRecords;
+		for (int task : batch)
+			newRecords.push_back(results[task]);
+		if (!newRecords.empty() && !AppendRecords(resultsPath, newRecords.data(), (int)newRecords.size()))
+			saved = false;
+		records.insert(records.end(), newRecords.begin(), newRecords.end());
+		done += (int)batch.size();
+
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		double perHour = done / seconds * 3600;
+		printf("\r%d / %d games  %.0f games/h  eta %.0fs   ", done, total, perHour, done > 0 ? (total - done) / (done / seconds) : 0.0);
+		fflush(stdout);
+	}
+	printf("\n");
+	for (thread& lane : lanes)
+		lane.join();
+	if (!saved)
+		printf("Failed to write %s\n", resultsPath.c_str());
+	PrintRatings(mode);
+	return saved;
+}
+
+// Elo in one mode with a 95% interval and the games behind it, best first
+void Arena::PrintRatings(int mode)
+{
+	vector<double> elo, margin;
+	vector<int> games;
+	Ratings(mode, elo, margin, games);
+	vector<int> order(players.size());
+	for (int i = 0; i < (int)order.size(); i++)
+		order[i] = i;
+	sort(order.begin(), order.end(), [&](int a, int b) { return elo[a] > elo[b]; });
+	for (int i : order)
+		printf("  %-24s %7.1f +- %5.1f  %d games\n", players[i].name.c_str(), elo[i], margin[i], games[i]);
+	fflush(stdout);
+}
+
+// FNV-1a of the name
+unsigned int Arena::PlayerId(const string& name)
+{
+	unsigned int id = 2166136261u;
+	for (char c : name)
+	{
+		id ^= (unsigned char)c;
+		id *= 16777619u;
+	}
+	return id;
+}
+
+ArenaRecord Arena::Play(const ArenaPlayer& a, const ArenaPlayer& b, int mode, unsigned int seed)
+{
+	ArenaRecord record = {};
+	record.seed = seed;
+	record.playerA = PlayerId(a.name);
+	record.playerB = PlayerId(b.name);
+	record.mode = (unsigned char)mode;
+	if (mode == GARBAGE)
+		PlayGarbage(a, b, record);
+	else
+		PlayRace(a, b, record);
+	return record;
+}
+
+// best score over every placement of type, lines included
+static float BestScore(const BitBoard& board, int type, const EvalWeights& weights)
+{
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	BitBoard boards[MoveGen::MAX_PLACEMENTS];
+	const BitBoard* boardPtr[MoveGen::MAX_PLACEMENTS];
+	int lines[MoveGen::MAX_PLACEMENTS];
+	float scores[MoveGen::MAX_PLACEMENTS];
+	int count = 0;
+	int placementNum = MoveGen::Generate(board, type, placements);
+	for (int i = 0; i < placementNum; i++)
+	{
+		boards[count] = board;
+		lines[count] = boards[count].Place(type, placements[i]);
+		if (boards[count].IsGameOver())
+			continue;
+		boardPtr[count] = &boards[count];
+		count += 1;
+	}
+	Evaluator::ScoreBatch(boardPtr, lines, count, weights, scores);
+	float best = LOSS;
+	for (int i = 0; i < count; i++)
+		best = max(best, scores[i]);
+	return best;
+}
+
+// false if the piece has no placement
+bool Arena::ChooseMove(const ArenaPlayer& player, const HeadlessGame& game, Placement& move)
+{
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	BitBoard boards[MoveGen::MAX_PLACEMENTS];
+	const BitBoard* boardPtr[MoveGen::MAX_PLACEMENTS];
+	int lines[MoveGen::MAX_PLACEMENTS];
+	float scores[MoveGen::MAX_PLACEMENTS];
+	int count = MoveGen::Generate(game.board, game.currType, placements);
+	if (count == 0)
+		return false;
+	for (int i = 0; i < count; i++)
+	{
+		boards[i] = game.board;
+		lines[i] = boards[i].Place(game.currType, placements[i]);
+		boardPtr[i] = &boards[i];
+	}
+	if (player.lookahead == 0)
+		Evaluator::ScoreBatch(boardPtr, lines, count, player.weights, scores);
+	float lineWeight = player.weights.weight[BoardFeatures::LINES];
+	int best = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if (boards[i].IsGameOver())
+			scores[i] = LOSS;
+		else if (player.lookahead > 0)
+			scores[i] = lines[i] * lineWeight + BestScore(boards[i], game.nextType, player.weights);
+		if (scores[i] > scores[best])
+			best = i;
+	}
+	move = placements[best];
+	return true;
+}
+
+// an mcts player searches its tree on the arena pool, anyone else plays as above
+bool Arena::ChooseMove(const ArenaPlayer& player, Mcts* tree, const HeadlessGame& game, Placement& move)
+{
+	if (tree == nullptr)
+		return ChooseMove(player, game, move);
+	atomic<bool> cancel(false);
+	return tree->Search(game, MCTS_MILLISECOND / 1000.0, MCTS_ROLLOUTS, game.pieces, player.weights, cancel, move);
+}
+
+void Arena::PlayRace(const ArenaPlayer& a, const ArenaPlayer& b, ArenaRecord& record)
+{
+	const ArenaPlayer* side[2] = { &a, &b };
+	int scores[2];
+	int pieces = 0;
+	for (int s = 0; s < 2; s++)
+	{
+		HeadlessGame game(record.seed);
+		unique_ptr<Mcts> tree(side[s]->mcts ? new Mcts(pool, MCTS_NODES) : nullptr);
+		if (tree)
+			tree->allowTucks = true;
+		Placement move;
+		while (!game.gameOver && game.pieces < RACE_PIECES && ChooseMove(*side[s], tree.get(), game, move))
+			game.Step(move);
+		scores[s] = game.scores;
+		pieces = max(pieces, game.pieces);
+	}
+	record.scoreA = scores[0];
+	record.scoreB = scores[1];
+	record.result = (signed char)(scores[0] > scores[1] ? 1 : scores[0] < scores[1] ? -1 : 0);
+	record.pieces = (unsigned short)pieces;
+}
+
+// a piece each in turn, attacks cancel pending garbage first and the rest goes to the other side, see Versus
+// pending garbage rises after a piece that clears nothing, with the hole in the same columns on both sides
+void Arena::PlayGarbage(const ArenaPlayer& a, const ArenaPlayer& b, ArenaRecord& record)
+{
+	const ArenaPlayer* side[2] = { &a, &b };
+	HeadlessGame games[2] = { HeadlessGame(record.seed), HeadlessGame(record.seed) };
+	mt19937 holes[2] = { mt19937(record.seed ^ 0x5BD1E995u), mt19937(record.seed ^ 0x5BD1E995u) };
+	uniform_int_distribution<int> column(1, BitBoard::WIDTH - 2);
+	VersusState states[2];
+	int sent[2] = { 0, 0 };
+	bool lost[2] = { false, false };
+	// a player's searcher lasts the game and searches on the arena pool
+	unique_ptr<Mcts> trees[2];
+	unique_ptr<Versus> versus[2];
+	for (int s = 0; s < 2; s++)
+		if (side[s]->versus)
+		{
+			versus[s].reset(new Versus(&pool));
+			versus[s]->weights = side[s]->weights;
+		}
+		else if (side[s]->mcts)
+		{
+			trees[s].reset(new Mcts(pool, MCTS_NODES));
+			trees[s]->allowTucks = true;
+		}
+	int piece = 0;
+	for (; piece < GARBAGE_PIECES && !lost[0] && !lost[1]; piece++)
+		for (int s = 0; s < 2 && !lost[0] && !lost[1]; s++)
+		{
+			HeadlessGame& game = games[s];
+			Placement move;
+			bool found;
+			if (versus[s])
+				found = versus[s]->Search(game, states[s], games[1 - s].board, states[1 - s].pending, Versus::FRAME_MILLISECOND, move);
+			else
+				found = ChooseMove(*side[s], trees[s].get(), game, move);
+			if (!found)
+			{
+				lost[s] = true;
+				break;
+			}
+			BitBoard before = game.board;
+			int type = game.currType;
+			int lines = game.Step(move);
+			int attack = Versus::Exchange(Versus::Attack(before, type, move, lines, game.board.IsPerfectClear(), states[s]), states[s]);
+			states[1 - s].pending += attack;
+			sent[s] += attack;
+			if (lines == 0 && states[s].pending > 0)
+			{
+				game.AddGarbage(states[s].pending, column(holes[s]));
+				states[s].pending = 0;
+			}
+			lost[s] = game.gameOver;
+		}
+
+	record.scoreA = sent[0];
+	record.scoreB = sent[1];
+	// a game nobody loses goes to the side that sent more
+	if (lost[0] != lost[1])
+		record.result = (signed char)(lost[1] ? 1 : -1);
+	else
+		record.result = (signed char)(sent[0] > sent[1] ? 1 : sent[0] < sent[1] ? -1 : 0);
+	record.pieces = (unsigned short)min(piece, 65535);
+}
+
+// a missing file is an empty one, a partly written last record is dropped
+// and the file rewritten without it, so appended records start on a whole record
+bool Arena::LoadRecords(const string& path)
+{
+	records.clear();
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return false;
+	ArenaRecord buffer[1024];
+	size_t count;
+	while ((count = fread(buffer, sizeof(ArenaRecord), 1024, file)) > 0)
+		records.insert(records.end(), buffer, buffer + count);
+	bool partial = ftell(file) != (long)(records.size() * sizeof(ArenaRecord));
+	fclose(file);
+	if (!partial)
+		return true;
+	file = fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	bool ok = fwrite(records.data(), sizeof(ArenaRecord), records.size(), file) == records.size();
+	return fclose(file) == 0 && ok;
+}
+
+bool Arena::AppendRecords(const string& path, const ArenaRecord* newRecords, int count)
+{
+	FILE* file = fopen(path.c_str(), "ab");
+	if (file == nullptr)
+		return false;
+	bool ok = fwrite(newRecords, sizeof(ArenaRecord), count, file) == (size_t)count;
+	return fclose(file) == 0 && ok;
+}
+
+int Arena::PlayerIndex(unsigned int id)
+{
+	for (int i = 0; i < (int)players.size(); i++)
+		if (PlayerId(players[i].name) == id)
+			return i;
+	return -1;
+}
+
+// Bradley-Terry strengths by minorization-maximization, the Elo fit to every game between current players
+// one virtual draw per pair keeps a player without wins finite, margin is 1.96 standard errors
+void Arena::Ratings(int mode, vector<double>& elo, vector<double>& margin, vector<int>& games)
+{
+	int n = (int)players.size();
+	vector<double> wins(n, 0);
+	vector<vector<double>> played(n, vector<double>(n, 0));
+	games.assign(n, 0);
+	for (const ArenaRecord& record : records)
+	{
+		int a = PlayerIndex(record.playerA);
+		int b = PlayerIndex(record.playerB);
+		if (record.mode != mode || a < 0 || b < 0 || a == b)
+			continue;
+		played[a][b] += 1;
+		played[b][a] += 1;
+		wins[a] += (record.result + 1) * 0.5;
+		wins[b] += (1 - record.result) * 0.5;
+		games[a] += 1;
+		games[b] += 1;
+	}
+	for (int a = 0; a < n; a++)
+		for (int b = 0; b < n; b++)
+			if (a != b)
+			{
+				played[a][b] += 1;
+				wins[a] += 0.5;
+			}
+
+	vector<double> strength(n, 1);
+	for (int iteration = 0; iteration < 1000; iteration++)
+	{
+		double logSum = 0;
+		for (int a = 0; a < n; a++)
+		{
+			double sum = 0;
+			for (int b = 0; b < n; b++)
+				if (a != b)
+					sum += played[a][b] / (strength[a] + strength[b]);
+			strength[a] = wins[a] / sum;
+			logSum += log(strength[a]);
+		}
+		// the average rating is 0
+		double mean = exp(logSum / n);
+		for (int a = 0; a < n; a++)
+			strength[a] /= mean;
+	}
+
+	const double scale = 400 / log(10.0);
+	elo.assign(n, 0);
+	margin.assign(n, 0);
+	for (int a = 0; a < n; a++)
+	{
+		double information = 0;
+		for (int b = 0; b < n; b++)
+			if (a != b)
+			{
+				double p = strength[a] / (strength[a] + strength[b]);
+				information += played[a][b] * p * (1 - p);
+			}
+		elo[a] = scale * log(strength[a]);
+		margin[a] = 1.96 * scale / sqrt(information);
+	}
+}
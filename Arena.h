@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Evaluator.h"
+#include "HeadlessGame.h"
+#include "ThreadPool.h"
+#include "Mcts.h"
+
+using namespace std;
+
+// one bot configuration playing in the arena
+struct ArenaPlayer
+{
+	string name;
+	EvalWeights weights;
+	// 0 places the current piece by static score, 1 also tries every placement of the next piece
+	int lookahead = 0;
+	// garbage games are played with the Versus search instead of lookahead
+	bool versus = false;
+	// every piece is placed by an Mcts search of Arena::MCTS_ROLLOUTS rollouts instead of lookahead
+	bool mcts = false;
+};
+
+// one finished game as stored in the results file, 24 bytes
+struct ArenaRecord
+{
+	unsigned int seed;
+	// Arena::PlayerId of the names, so old results still count after players are added or removed
+	unsigned int playerA;
+	unsigned int playerB;
+	unsigned char mode;
+	// 1 if A won, 0 for a draw, -1 if B won
+	signed char result;
+	unsigned short pieces;
+	// points in a race, lines of garbage sent in a garbage game
+	int scoreA;
+	int scoreB;
+};
+
+// plays every pair of players on the same seeded games, one lane thread per core, and rates them with Elo
+// the thread pool is left to the searches of versus and mcts players
+// results are appended to a binary file of ArenaRecord, the ratings use every game in it between current players
+class Arena
+{
+public:
+	// both play the same pieces alone for RACE_PIECES, the higher score wins
+	static const int RACE = 0;
+	// both play the same pieces in turns sending garbage by the Versus rules, the first to top out loses
+	static const int GARBAGE = 1;
+	static const int RACE_PIECES = 1000;
+	static const int GARBAGE_PIECES = 2000;
+	static const int PROGRESS_MILLISECOND = 1000;
+	// rollouts per piece of an mcts player, the time only caps a slow machine
+	static const int MCTS_ROLLOUTS = 1000;
+	static const int MCTS_MILLISECOND = 1000;
+	// each iteration adds and expands at most one node, so neither nodes nor edges run out before the rollouts
+	static const int MCTS_NODES = 1 << 12;
+private:
+	ThreadPool pool;
+	vector<ArenaPlayer> players;
+	vector<ArenaRecord> records;
+public:
+	void AddPlayer(const ArenaPlayer& player);
+	bool Run(const string& resultsPath, int mode, int gamesPerPair);
+	void PrintRatings(int mode);
+	static unsigned int PlayerId(const string& name);
+	ArenaRecord Play(const ArenaPlayer& a, const ArenaPlayer& b, int mode, unsigned int seed);
+	static bool ChooseMove(const ArenaPlayer& player, const HeadlessGame& game, Placement& move);
+private:
+	static bool ChooseMove(const ArenaPlayer& player, Mcts* tree, const HeadlessGame& game, Placement& move);
+	void PlayRace(const ArenaPlayer& a, const ArenaPlayer& b, ArenaRecord& record);
+	void PlayGarbage(const ArenaPlayer& a, const ArenaPlayer& b, ArenaRecord& record);
+	bool LoadRecords(const string& path);
+	static bool AppendRecords(const string& path, const ArenaRecord* newRecords, int count);
+	int PlayerIndex(unsigned int id);
+	void Ratings(int mode, vector<double>& elo, vector<double>& margin, vector<int>& games);
+};
@@ -0,0 +1,137 @@
+#include "BeamSearch.h"
+
+BeamSearch::BeamSearch(ThreadPool& threadPool) : pool(threadPool), evalCache(EVAL_CACHE_SIZE_LOG2), seen(SEEN_SIZE_LOG2)
+{
+	weightsKey = 0;
+	searchNum = 0;
+}
+
+// keep the width best boards after each piece of the queue, return false if cancelled or no move survives
+bool BeamSearch::Search(const BitBoard& board, const int* queue, int queueLength, int width, const EvalWeights& weights, const atomic<bool>& cancel, Placement& best)
+{
+	if (queueLength <= 0)
+		return false;
+	// buffers only grow, so a search doesn't allocate once warmed up
+	if ((int)children.size() < width * MoveGen::MAX_PLACEMENTS)
+		children.resize(width * MoveGen::MAX_PLACEMENTS);
+	if ((int)order.size() < width * MoveGen::MAX_PLACEMENTS)
+		order.resize(width * MoveGen::MAX_PLACEMENTS);
+	childCount.assign(width, 0);
+	beam.resize(1);
+	beam[0].board = board;
+	beam[0].score = 0;
+	beam[0].lines = 0;
+	beam[0].first = -1;
+	weightsKey = weights.Key();
+	searchNum += 1;
+
+	// the first piece is expanded on its own to fix the index of each first placement
+	int count = Expand(beam[0], queue[0], weights, &children[0], true);
+	for (int depth = 0; ; depth++)
+	{
+		// keep the best width children
+		for (int i = 0; i < count; i++)
+			order[i] = i;
+		int keep = min(width, count);
+		nth_element(order.begin(), order.begin() + keep - (keep > 0), order.begin() + count, [this](int a, int b) { return children[a].score > children[b].score; });
+		beam.resize(keep);
+		for (int i = 0; i < keep; i++)
+			beam[i] = children[order[i]];
+		if (keep == 0 || cancel)
+			return false;
+		if (depth + 1 == queueLength)
+			break;
+
+		int type = queue[depth + 1];
+		pool.ParallelFor(keep, [&](int i) {
+			childCount[i] = cancel ? 0 : Expand(beam[i], type, weights, &children[i * MoveGen::MAX_PLACEMENTS], false);
+		});
+
+		// pack the children of every node together
+		// a board reached again through another order of placements is dropped, in node order so the result doesn't depend on threads
+		HashKey depthKey = BitBoard::Mix(3ULL << 56 | (HashKey)searchNum << 8 | (HashKey)(depth + 1));
+		count = 0;
+		for (int i = 0; i < keep; i++)
+			for (int j = 0; j < childCount[i]; j++)
+			{
+				BeamNode& child = children[i * MoveGen::MAX_PLACEMENTS + j];
+				TableEntry entry;
+				if (seen.Probe(child.board.hash ^ depthKey, entry))
+					continue;
+				seen.Store(child.board.hash ^ depthKey, entry);
+				children[count++] = child;
+			}
+	}
+
+	int bestIndex = 0;
+	for (int i = 1; i < (int)beam.size(); i++)
+		if (beam[i].score > beam[bestIndex].score)
+			bestIndex = i;
+	best = firstPlacements[beam[bestIndex].first];
+	return true;
+}
+
+// write every surviving child of node to out and return how many
+int BeamSearch::Expand(const BeamNode& node, int type, const EvalWeights& weights, BeamNode* out, bool root)
+{
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	int placementNum = MoveGen::Generate(node.board, type, placements);
+	if (root)
+		firstPlacements.clear();
+
+	int count = 0;
+	for (int i = 0; i < placementNum; i++)
+	{
+		if (placements[i].tuck && !allowTucks)
+			continue;
+		BeamNode& child = out[count];
+		child.board = node.board;
+		child.lines = node.lines + child.board.Place(type, placements[i]);
+		if (child.board.IsGameOver())
+			continue;
+		if (root)
+		{
+			child.first = (int)firstPlacements.size();
+			firstPlacements.push_back(placements[i]);
+		}
+		else
+			child.first = node.first;
+		count += 1;
+	}
+	Score(out, count, weights);
+	return count;
+}
+
+// cached board scores are reused, the rest are evaluated together in one batch
+void BeamSearch::Score(BeamNode* nodes, int count, const EvalWeights& weights)
+{
+	const BitBoard* boards[MoveGen::MAX_PLACEMENTS];
+	int index[MoveGen::MAX_PLACEMENTS];
+	int noLines[MoveGen::MAX_PLACEMENTS] = {};
+	float scores[MoveGen::MAX_PLACEMENTS];
+	int missNum = 0;
+	for (int i = 0; i < count; i++)
+	{
+		TableEntry entry;
+		if (evalCache.Probe(nodes[i].board.hash ^ weightsKey, entry))
+			nodes[i].score = entry.value;
+		else
+		{
+			boards[missNum] = &nodes[i].board;
+			index[missNum++] = i;
+		}
+	}
+
+	// every board may already be cached
+	if (missNum > 0)
+		Evaluator::ScoreBatch(boards, noLines, missNum, weights, scores);
+	for (int i = 0; i < missNum; i++)
+	{
+		TableEntry entry;
+		entry.value = scores[i];
+		evalCache.Store(nodes[index[i]].board.hash ^ weightsKey, entry);
+		nodes[index[i]].score = scores[i];
+	}
+	for (int i = 0; i < count; i++)
+		nodes[i].score += nodes[i].lines * weights.weight[BoardFeatures::LINES];
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include "Evaluator.h"
+#include "MoveGen.h"
+#include "ThreadPool.h"
+#include "TranspositionTable.h"
+
+struct BeamNode
+{
+	BitBoard board;
+	float score;
+	int lines;
+	// index of the placement of the first piece this node came from
+	int first;
+};
+
+// beam search over a queue of pieces, the nodes of each depth are expanded in parallel on the pool
+class BeamSearch
+{
+public:
+	static const int DEFAULT_WIDTH = 64;
+	// small enough to stay in cache, a search of the default width stores about 10000 boards
+	static const int EVAL_CACHE_SIZE_LOG2 = 16;
+	static const int SEEN_SIZE_LOG2 = 15;
+	bool allowTucks = false;
+private:
+	ThreadPool& pool;
+	vector<BeamNode> beam;
+	vector<BeamNode> children;
+	vector<int> childCount;
+	vector<int> order;
+	vector<Placement> firstPlacements;
+	// board scores without the line term, kept across searches while the weights stay the same
+	TranspositionTable evalCache;
+	// boards already in the beam, keyed with the search and depth so old entries never match
+	TranspositionTable seen;
+	HashKey weightsKey;
+	unsigned int searchNum;
+public:
+	BeamSearch(ThreadPool& threadPool);
+	bool Search(const BitBoard& board, const int* queue, int queueLength, int width, const EvalWeights& weights, const atomic<bool>& cancel, Placement& best);
+private:
+	int Expand(const BeamNode& node, int type, const EvalWeights& weights, BeamNode* out, bool root);
+	void Score(BeamNode* nodes, int count, const EvalWeights& weights);
+};
@@ -0,0 +1,292 @@
+#include "BitBoard.h"
+
+Placement::Placement()
+{
+}
+
+Placement::Placement(int xPos, int yPos, int rot, bool isTuck)
+{
+	x = xPos;
+	y = yPos;
+	rotation = rot;
+	tuck = isTuck;
+}
+
+bool Placement::operator==(const Placement& other) const
+{
+	return x == other.x && y == other.y && rotation == other.rotation;
+}
+
+struct PieceTables
+{
+	RowMask rows[7][4][4];
+	int rotateX[7][4][BitBoard::MAX_X - BitBoard::MIN_X + 1];
+	int canonical[7][4];
+	// rot at (x, y) covers the same cells as canonical at (x + dx, y + dy)
+	int canonicalDx[7][4];
+	int canonicalDy[7][4];
+	PieceTables();
+};
+
+// rotate every piece the way Game::Rotate does and record the wall adjustment for every x
+PieceTables::PieceTables()
+{
+	for (int type = 0; type < 7; type++)
+	{
+		string shape = Game::PIECE[type];
+		for (int rot = 0; rot < 4; rot++)
+		{
+			for (int y = 0; y < 4; y++)
+			{
+				rows[type][rot][y] = 0;
+				for (int x = 0; x < 4; x++)
+					if (shape[y * 4 + x] == 'x')
+						rows[type][rot][y] |= 1u << x;
+			}
+
+			string rotated(16, '.');
+			for (int y = 0; y < 4; y++)
+				for (int x = 0; x < 4; x++)
+					rotated[y * 4 + x] = shape[y + 12 - 4 * x];
+
+			// rotating from rot at xPos tries the rotated shape at rotateX
+			for (int xPos = BitBoard::MIN_X; xPos <= BitBoard::MAX_X; xPos++)
+			{
+				int tempXPos = xPos;
+				for (int y = 0; y < 4; y++)
+					for (int x = 0; x < 4; x++)
+						if (rotated[y * 4 + x] == 'x' && xPos + x <= 0)
+							tempXPos += 1;
+						else if (rotated[y * 4 + x] == 'x' && xPos + x >= Game::GAMEBOARD_WIDTH - 1)
+							tempXPos -= 1;
+				rotateX[type][rot][xPos - BitBoard::MIN_X] = tempXPos;
+			}
+			shape = rotated;
+		}
+	}
+
+	// rotations with the same cells up to a shift (O, I, S, Z) map to the first of them
+	for (int type = 0; type < 7; type++)
+		for (int rot = 0; rot < 4; rot++)
+		{
+			canonical[type][rot] = rot;
+			canonicalDx[type][rot] = 0;
+			canonicalDy[type][rot] = 0;
+			for (int other = 0; other < rot && canonical[type][rot] == rot; other++)
+				for (int dy = -3; dy <= 3 && canonical[type][rot] == rot; dy++)
+					for (int dx = -3; dx <= 3 && canonical[type][rot] == rot; dx++)
+					{
+						// both shapes have four cells, so matching every row of rot is enough
+						bool same = true;
+						for (int y = 0; y < 4 && same; y++)
+						{
+							RowMask moved = (y + dy >= 0 && y + dy < 4) ? rows[type][other][y + dy] << (dx + 3) : 0;
+							same = moved == rows[type][rot][y] << 3;
+						}
+						if (same)
+						{
+							canonical[type][rot] = other;
+							canonicalDx[type][rot] = dx;
+							canonicalDy[type][rot] = -dy;
+						}
+					}
+		}
+}
+
+// built on first use, Game::PIECE may not be initialized during static initialization
+static const PieceTables& Tables()
+{
+	static PieceTables tables;
+	return tables;
+}
+
+BitBoard::BitBoard()
+{
+	Clear();
+}
+
+void BitBoard::Clear()
+{
+	for (int y = 0; y < HEIGHT - 1; y++)
+		rows[y] = EMPTY_ROW;
+	rows[HEIGHT - 1] = FULL_ROW;
+	hash = 0;
+}
+
+void BitBoard::FromGameboard(const char* gameboard)
+{
+	FromGameboard(gameboard, 0);
+	Rehash();
+}
+
+// the hash already known, as Game keeps it while the board changes
+void BitBoard::FromGameboard(const char* gameboard, HashKey knownHash)
+{
+	Clear();
+	for (int y = 0; y < HEIGHT; y++)
+		for (int x = 0; x < WIDTH; x++)
+			if (gameboard[y * WIDTH + x] == 'x' || gameboard[y * WIDTH + x] == 'o')
+				rows[y] |= 1u << (x + PAD);
+	hash = knownHash;
+}
+
+// recompute the hash after rows were changed directly
+void BitBoard::Rehash()
+{
+	hash = 0;
+	for (int y = 0; y < HEIGHT - 1; y++)
+		hash ^= HashRow(rows[y], y);
+}
+
+// mix the filled cells of a row with its index, empty rows hash to 0 so only the stack costs anything
+HashKey BitBoard::HashRow(RowMask row, int y)
+{
+	row &= FIELD;
+	if (row == 0)
+		return 0;
+	return Mix((HashKey)row << 32 | (HashKey)(y + 1));
+}
+
+// the top byte keeps these apart from the row keys
+HashKey BitBoard::HashQueue(int pos, int type)
+{
+	return Mix(2ULL << 56 | (HashKey)pos << 8 | (HashKey)type);
+}
+
+// splitmix64 finalizer
+HashKey BitBoard::Mix(HashKey key)
+{
+	key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+	return key ^ (key >> 31);
+}
+
+bool BitBoard::Fits(int type, int rot, int x, int y) const
+{
+	if (x < MIN_X || x > MAX_X || y < 0)
+		return false;
+	const RowMask* piece = Tables().rows[type][rot];
+	for (int i = 0; i < 4; i++)
+		if (piece[i] && (y + i >= HEIGHT || (piece[i] << (x + PAD)) & rows[y + i]))
+			return false;
+	return true;
+}
+
+// lowest y the piece falls to from (x, y)
+int BitBoard::Drop(int type, int rot, int x, int y) const
+{
+	while (Fits(type, rot, x, y + 1))
+		y += 1;
+	return y;
+}
+
+// lock the piece and clear finished lines like Game::Update and Game::CheckLine, return the lines cleared
+int BitBoard::Place(int type, int rot, int x, int y)
+{
+	const RowMask* piece = Tables().rows[type][rot];
+	for (int i = 0; i < 4; i++)
+		if (piece[i])
+		{
+			hash ^= HashRow(rows[y + i], y + i);
+			rows[y + i] |= piece[i] << (x + PAD);
+			hash ^= HashRow(rows[y + i], y + i);
+		}
+
+	// a cleared line moves every row above it, so those rows are hashed again at their new index
+	int linesNum = 0;
+	for (int i = 0; i < 4; i++)
+		if (y + i < HEIGHT - 1 && (rows[y + i] & FIELD) == FIELD)
+		{
+			for (int row = y + i; row > 0; row--)
+			{
+				hash ^= HashRow(rows[row], row) ^ HashRow(rows[row - 1], row);
+				rows[row] = rows[row - 1];
+			}
+			hash ^= HashRow(rows[0], 0);
+			rows[0] = EMPTY_ROW;
+			linesNum += 1;
+		}
+	return linesNum;
+}
+
+int BitBoard::Place(int type, const Placement& placement)
+{
+	return Place(type, placement.rotation, placement.x, placement.y);
+}
+
+// push linesNum full rows with an empty cell at column hole in under the stack, for versus play
+// return false if filled cells were pushed out of the top
+bool BitBoard::AddGarbage(int linesNum, int hole)
+{
+	bool fits = true;
+	for (int y = 0; y < linesNum; y++)
+		if (rows[y] & FIELD)
+			fits = false;
+	for (int y = 0; y < HEIGHT - 1 - linesNum; y++)
+		rows[y] = rows[y + linesNum];
+	for (int y = max(0, HEIGHT - 1 - linesNum); y < HEIGHT - 1; y++)
+		rows[y] = FULL_ROW & ~(1u << (hole + PAD));
+	Rehash();
+	return fits;
+}
+
+bool BitBoard::IsPerfectClear() const
+{
+	for (int y = 0; y < HEIGHT - 1; y++)
+		if (rows[y] & FIELD)
+			return false;
+	return true;
+}
+
+bool BitBoard::IsGameOver() const
+{
+	for (int y = 0; y < Game::BUFFER_HEIGHT; y++)
+		if (rows[y] & FIELD)
+			return true;
+	return false;
+}
+
+int BitBoard::CountFilled() const
+{
+	int count = 0;
+	for (int y = 0; y < HEIGHT - 1; y++)
+		count += PopCount(rows[y] & FIELD);
+	return count;
+}
+
+bool BitBoard::operator==(const BitBoard& other) const
+{
+	for (int y = 0; y < HEIGHT; y++)
+		if (rows[y] != other.rows[y])
+			return false;
+	return true;
+}
+
+const RowMask* BitBoard::PieceRows(int type, int rot)
+{
+	return Tables().rows[type][rot];
+}
+
+// x the rotated piece is tried at after the wall adjustment in Game::Rotate
+int BitBoard::RotateX(int type, int rot, int x)
+{
+	if (x < MIN_X || x > MAX_X)
+		return x;
+	return Tables().rotateX[type][rot][x - MIN_X];
+}
+
+int BitBoard::CanonicalRotation(int type, int rot)
+{
+	return Tables().canonical[type][rot];
+}
+
+void BitBoard::CanonicalOffset(int type, int rot, int& dx, int& dy)
+{
+	dx = Tables().canonicalDx[type][rot];
+	dy = Tables().canonicalDy[type][rot];
+}
+
+void BitBoard::InitTables()
+{
+	Tables();
+}
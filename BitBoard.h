@@ -0,0 +1,88 @@
+#pragma once
+#include "Game.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+typedef unsigned int RowMask;
+typedef unsigned long long HashKey;
+
+inline int PopCount(RowMask mask)
+{
+#ifdef _MSC_VER
+	return (int)__popcnt(mask);
+#else
+	return __builtin_popcount(mask);
+#endif
+}
+
+// index of the lowest set bit, mask must not be 0
+inline int LowestBit(RowMask mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// final position of a piece, (x, y) is the top left of its 4x4 box like xPos and yPos in Game
+struct Placement
+{
+	int x = 0;
+	int y = 0;
+	int rotation = 0;
+	// reached by soft dropping and sliding under an overhang instead of a plain hard drop
+	bool tuck = false;
+	Placement();
+	Placement(int xPos, int yPos, int rot, bool isTuck);
+	bool operator==(const Placement& other) const;
+};
+
+// gameboard with one bit mask per row, used by the bots instead of the char gameboard
+// column x is bit x + PAD, everything outside the gameboard is filled so pieces hitting it are invalid
+struct BitBoard
+{
+	static const int WIDTH = Game::GAMEBOARD_WIDTH;
+	static const int HEIGHT = Game::GAMEBOARD_HEIGHT;
+	static const int PAD = 4;
+	static const int MIN_X = -PAD;
+	static const int MAX_X = WIDTH;
+	static const RowMask EMPTY_ROW = ~(((1u << (WIDTH - 2)) - 1) << (PAD + 1));
+	static const RowMask FULL_ROW = 0xFFFFFFFF;
+	// filled cells of the playfield, walls excluded
+	static const RowMask FIELD = ~EMPTY_ROW;
+
+	RowMask rows[HEIGHT];
+	// xor of HashRow over every row, kept up to date by Place
+	HashKey hash;
+
+	BitBoard();
+	void Clear();
+	void FromGameboard(const char* gameboard);
+	void FromGameboard(const char* gameboard, HashKey knownHash);
+	void Rehash();
+	bool Fits(int type, int rot, int x, int y) const;
+	int Drop(int type, int rot, int x, int y) const;
+	int Place(int type, int rot, int x, int y);
+	int Place(int type, const Placement& placement);
+	bool AddGarbage(int linesNum, int hole);
+	bool IsPerfectClear() const;
+	bool IsGameOver() const;
+	int CountFilled() const;
+	bool operator==(const BitBoard& other) const;
+
+	// a row's share of the board hash, and a key xored on top of it for a queued piece
+	static HashKey HashRow(RowMask row, int y);
+	static HashKey HashQueue(int pos, int type);
+	static HashKey Mix(HashKey key);
+
+	// piece tables built from Game::PIECE, rotated the same way as Game::Rotate
+	static const RowMask* PieceRows(int type, int rot);
+	static int RotateX(int type, int rot, int x);
+	static int CanonicalRotation(int type, int rot);
+	static void CanonicalOffset(int type, int rot, int& dx, int& dy);
+	static void InitTables();
+};
@@ -0,0 +1,213 @@
+#include "Bot.h"
+#include <algorithm>
+
+const float Bot::PC_MIN_CHANCE = 0.5f;
+
+const BotLevel Bot::LEVEL[LEVELS] = {
+	{ 0, 0, 0, false, 3, 0.30f, 6 },
+	{ 0, 0, 0, false, 4, 0.20f, 5 },
+	{ 10, 500, 0, false, 5, 0.15f, 4 },
+	{ 20, 1000, 8, false, 6, 0.10f, 4 },
+	{ 30, 2000, 16, false, 8, 0.07f, 3 },
+	{ 50, 3000, 32, false, 10, 0.05f, 3 },
+	{ 80, 10000, BEAM_WIDTH, true, 12, 0.03f, 2 },
+	{ 120, 30000, BEAM_WIDTH, true, 15, 0.01f, 2 },
+	{ 200, 100000, BEAM_WIDTH, true, 20, 0, 0 },
+	{ MAX_THINK_MILLISECOND, 0, BEAM_WIDTH, true, 0, 0, 0 }
+};
+
+Bot::Bot() : beamSearch(pool), expectimax(pool), perfectClear(pool)
+{
+	quit = false;
+	hasRequest = false;
+	currType = 0;
+	nextType = 0;
+	bagMask = Expectimax::FULL_BAG;
+	thinkMillisecond = MIN_THINK_MILLISECOND;
+	cancel = false;
+	done = true;
+	hasBest = false;
+	level = LEVEL[DEFAULT_LEVEL];
+	random.seed(random_device()());
+	// Finesse finds keys for soft drops and tucks too
+	beamSearch.allowTucks = true;
+	expectimax.allowTucks = true;
+	perfectClear.allowTucks = true;
+	// deeper expectimax in the same time, see SurfaceFit
+	expectimax.cleanFitsOnly = true;
+	worker = thread(&Bot::Work, this);
+}
+
+Bot::~Bot()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		quit = true;
+		cancel = true;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+// start searching a new piece, any search still running is abandoned
+// bag is the mask of pieces that can still come after next, see Expectimax
+// the search keeps deepening for millisecond, a best move is ready from the first few microseconds on
+void Bot::Request(const BitBoard& newBoard, int curr, int next, int bag, int millisecond)
+{
+	{
+		lock_guard<mutex> guard(lock);
+		board = newBoard;
+		currType = curr;
+		nextType = next;
+		bagMask = bag;
+		thinkMillisecond = millisecond;
+		hasRequest = true;
+		done = false;
+		hasBest = false;
+		cancel = true;
+	}
+	wake.notify_one();
+}
+
+void Bot::Cancel()
+{
+	cancel = true;
+}
+
+bool Bot::IsDone()
+{
+	lock_guard<mutex> guard(lock);
+	return done;
+}
+
+// best placement found so far for the latest request
+bool Bot::GetBest(Placement& move)
+{
+	lock_guard<mutex> guard(lock);
+	if (hasBest)
+		move = best;
+	return hasBest;
+}
+
+void Bot::SetWeights(const EvalWeights& newWeights)
+{
+	lock_guard<mutex> guard(lock);
+	weights = newWeights;
+}
+
+// score boards with a network instead of the feature weights, call it before the first Request
+// the search reads the network without the lock
+bool Bot::LoadNetwork(const string& path)
+{
+	lock_guard<mutex> guard(lock);
+	if (!network.Load(path))
+		return false;
+	weights.network = &network;
+	return true;
+}
+
+void Bot::SetLevel(int index)
+{
+	lock_guard<mutex> guard(lock);
+	level = LEVEL[max(0, min(LEVELS - 1, index))];
+}
+
+void Bot::Work()
+{
+	while (true)
+	{
+		BitBoard searchBoard;
+		int curr, next, bag, millisecond;
+		EvalWeights searchWeights;
+		BotLevel searchLevel;
+		{
+			unique_lock<mutex> guard(lock);
+			wake.wait(guard, [this] { return quit || hasRequest; });
+			if (quit)
+				return;
+			searchBoard = board;
+			curr = currType;
+			next = nextType;
+			bag = bagMask;
+			millisecond = thinkMillisecond;
+			searchWeights = weights;
+			searchLevel = level;
+			hasRequest = false;
+			cancel = false;
+		}
+
+		Search(searchBoard, curr, next, bag, millisecond, searchWeights, searchLevel);
+
+		lock_guard<mutex> guard(lock);
+		if (!hasRequest)
+			done = true;
+	}
+}
+
+// anytime search: a greedy move first so there is always an answer, a perfect clear if one is likely,
+// otherwise a beam search over the queue and then expectimax past it one piece deeper at a time until the time is used up
+// the level cuts each stage short, and a mistake skips the search for a worse placement by static score
+void Bot::Search(const BitBoard& searchBoard, int curr, int next, int bag, int millisecond, const EvalWeights& searchWeights, const BotLevel& searchLevel)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	float scores[MoveGen::MAX_PLACEMENTS];
+	int order[MoveGen::MAX_PLACEMENTS];
+	int count = MoveGen::Generate(searchBoard, curr, placements);
+	for (int i = 0; i < count; i++)
+	{
+		BitBoard after = searchBoard;
+		int lines = after.Place(curr, placements[i]);
+		scores[i] = after.IsGameOver() ? -1e9f : Evaluator::Score(after, lines, searchWeights);
+		order[i] = i;
+	}
+	if (count == 0)
+		return;
+	stable_sort(order, order + count, [&](int a, int b) { return scores[a] > scores[b]; });
+	SetBest(placements[order[0]]);
+
+	if (count > 1 && searchLevel.mistakeRange > 0 && uniform_real_distribution<float>(0, 1)(random) < searchLevel.mistakeChance)
+	{
+		int rank = 1 + uniform_int_distribution<int>(0, min(searchLevel.mistakeRange, count - 1) - 1)(random);
+		// a mistake never tops out when the best placement doesn't
+		if (scores[order[rank]] > -1e9f)
+			SetBest(placements[order[rank]]);
+		return;
+	}
+
+	int queue[2] = { curr, next };
+	Placement move;
+	// a likely perfect clear beats anything the evaluator would pick
+	int piecesNeeded;
+	if (searchLevel.perfectClear && PerfectClear::Feasible(searchBoard, PC_HEIGHT, piecesNeeded) && piecesNeeded <= PC_MAX_PIECES
+		&& perfectClear.Solve(searchBoard, queue, 2, bag, PC_HEIGHT, cancel, move) >= PC_MIN_CHANCE)
+	{
+		SetBest(move);
+		return;
+	}
+
+	if (searchLevel.beamWidth > 0 && beamSearch.Search(searchBoard, queue, 2, searchLevel.beamWidth, searchWeights, cancel, move))
+		SetBest(move);
+
+	millisecond = min(millisecond, searchLevel.thinkMillisecond);
+	double seconds = millisecond / 1000.0 - chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if (seconds <= 0)
+		return;
+	// after a beam search only depths past the queue see further, without one depth 2 already beats the greedy move
+	int firstDepth = searchLevel.beamWidth > 0 ? 3 : 2;
+	expectimax.maxNodes = searchLevel.maxNodes;
+	expectimax.Search(searchBoard, queue, 2, bag, seconds, searchWeights, cancel, move, [this, firstDepth](const Placement& depthBest, int depth) {
+		if (depth >= firstDepth)
+			SetBest(depthBest);
+	});
+}
+
+void Bot::SetBest(const Placement& move)
+{
+	lock_guard<mutex> guard(lock);
+	// a newer request makes this result stale
+	if (hasRequest)
+		return;
+	best = move;
+	hasBest = true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <random>
+#include "Evaluator.h"
+#include "NeuralEvaluator.h"
+#include "MoveGen.h"
+#include "BeamSearch.h"
+#include "Expectimax.h"
+#include "PerfectClear.h"
+
+// how strong the bot plays, weaker levels search less and leave the cpu idle instead of throwing work away
+struct BotLevel
+{
+	// longest search per piece, the time the piece has still caps it, 0 places by static score only
+	int thinkMillisecond;
+	// expectimax nodes per piece, 0 for no limit; depth 3 takes up to about 450 and depth 4 up to about 8000
+	long long maxNodes;
+	// 0 skips the beam search
+	int beamWidth;
+	bool perfectClear;
+	// key presses per second of autoplay, 0 for one every frame
+	int actionsPerSecond;
+	// chance a piece goes to one of the next mistakeRange placements by static score, without searching
+	float mistakeChance;
+	int mistakeRange;
+};
+
+// searches placements on a worker thread, the game only polls it so a slow search never stalls a frame
+class Bot
+{
+public:
+	// bounds of the time given to one piece, see Game::GetThinkMillisecond
+	static const int MIN_THINK_MILLISECOND = 10;
+	static const int MAX_THINK_MILLISECOND = 300;
+	// frames the keys of a move take at one key per frame, with room for three rotations and five shifts
+	static const int KEY_FRAMES = 10;
+	static const int BEAM_WIDTH = BeamSearch::DEFAULT_WIDTH;
+	// perfect clears are looked for when the board needs at most PC_MAX_PIECES more pieces within PC_HEIGHT rows
+	// past that the solver takes too long for a piece, see PerfectClear
+	static const int PC_HEIGHT = 4;
+	static const int PC_MAX_PIECES = 6;
+	static const float PC_MIN_CHANCE;
+	static const int LEVELS = 10;
+	// weakest first, the last level is the full search
+	static const BotLevel LEVEL[LEVELS];
+	static const int DEFAULT_LEVEL = LEVELS - 1;
+private:
+	ThreadPool pool;
+	BeamSearch beamSearch;
+	Expectimax expectimax;
+	PerfectClear perfectClear;
+	thread worker;
+	mutex lock;
+	condition_variable wake;
+	bool quit;
+	// request, guarded by lock
+	bool hasRequest;
+	BitBoard board;
+	int currType;
+	int nextType;
+	int bagMask;
+	int thinkMillisecond;
+	atomic<bool> cancel;
+	// result of the latest request, guarded by lock
+	bool done;
+	bool hasBest;
+	Placement best;
+	EvalWeights weights;
+	NeuralEvaluator network;
+	BotLevel level;
+	// mistakes, only used by the worker
+	mt19937 random;
+public:
+	Bot();
+	~Bot();
+	void Request(const BitBoard& newBoard, int curr, int next, int bag, int millisecond);
+	void Cancel();
+	bool IsDone();
+	bool GetBest(Placement& move);
+	void SetWeights(const EvalWeights& newWeights);
+	bool LoadNetwork(const string& path);
+	void SetLevel(int index);
+private:
+	void Work();
+	void Search(const BitBoard& searchBoard, int curr, int next, int bag, int millisecond, const EvalWeights& searchWeights, const BotLevel& searchLevel);
+	void SetBest(const Placement& move);
+};
@@ -0,0 +1,237 @@
+#include "Evaluator.h"
+#include "NeuralEvaluator.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define EVALUATOR_X86
+#include <immintrin.h>
+// the AVX2 kernel is compiled for every build and only called after checking the cpu
+#ifdef _MSC_VER
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+const char* BoardFeatures::NAME[NUM] = {
+	"aggregate height",
+	"holes",
+	"bumpiness",
+	"row transitions",
+	"column transitions",
+	"wells",
+	"max height",
+	"lines"
+};
+
+// hand tuned starting point
+EvalWeights::EvalWeights()
+{
+	weight[BoardFeatures::AGGREGATE_HEIGHT] = -0.5f;
+	weight[BoardFeatures::HOLES] = -4.0f;
+	weight[BoardFeatures::BUMPINESS] = -0.2f;
+	weight[BoardFeatures::ROW_TRANSITIONS] = -0.3f;
+	weight[BoardFeatures::COLUMN_TRANSITIONS] = -0.9f;
+	weight[BoardFeatures::WELLS] = -0.35f;
+	weight[BoardFeatures::MAX_HEIGHT] = -0.2f;
+	weight[BoardFeatures::LINES] = 0.8f;
+	network = nullptr;
+}
+
+HashKey EvalWeights::Key() const
+{
+	HashKey key = 4ULL << 56;
+	for (int i = 0; i < BoardFeatures::NUM; i++)
+	{
+		unsigned int bits;
+		memcpy(&bits, &weight[i], sizeof(bits));
+		key = BitBoard::Mix(key ^ bits);
+	}
+	if (network)
+		key = BitBoard::Mix(key ^ network->Key());
+	return key;
+}
+
+// pairs of neighbouring playfield columns, bit x + PAD stands for columns x and x + 1
+static const RowMask PAIRS = BitBoard::FIELD & (BitBoard::FIELD >> 1);
+// row transitions are counted between column x and x + 1 for x = 0 .. WIDTH - 2, walls included
+static const RowMask EDGES = ((1u << (BitBoard::WIDTH - 1)) - 1) << BitBoard::PAD;
+
+// every feature is a popcount per row: covered marks columns with a filled cell at or above the row
+void Evaluator::Features(const BitBoard& board, int linesCleared, BoardFeatures& features)
+{
+	for (int i = 0; i < BoardFeatures::NUM; i++)
+		features.value[i] = 0;
+
+	RowMask covered = 0;
+	RowMask above = BitBoard::EMPTY_ROW;
+	for (int y = 0; y < BitBoard::HEIGHT - 1; y++)
+	{
+		RowMask row = board.rows[y];
+		RowMask filled = row & BitBoard::FIELD;
+		if (covered == 0 && filled == 0)
+			continue;
+		if (covered == 0)
+			features.value[BoardFeatures::MAX_HEIGHT] = BitBoard::HEIGHT - 1 - y;
+
+		// well cells are open from above with both sides filled
+		features.value[BoardFeatures::WELLS] += PopCount(~row & ~covered & (row << 1) & (row >> 1) & BitBoard::FIELD);
+		features.value[BoardFeatures::HOLES] += PopCount(~row & covered & BitBoard::FIELD);
+		covered |= filled;
+		features.value[BoardFeatures::AGGREGATE_HEIGHT] += PopCount(covered);
+		features.value[BoardFeatures::BUMPINESS] += PopCount((covered ^ (covered >> 1)) & PAIRS);
+		features.value[BoardFeatures::ROW_TRANSITIONS] += PopCount((row ^ (row >> 1)) & EDGES);
+		features.value[BoardFeatures::COLUMN_TRANSITIONS] += PopCount((row ^ above) & BitBoard::FIELD);
+		above = row;
+	}
+	// bottom row against the floor
+	features.value[BoardFeatures::COLUMN_TRANSITIONS] += PopCount((board.rows[BitBoard::HEIGHT - 1] ^ above) & BitBoard::FIELD);
+	features.value[BoardFeatures::LINES] = linesCleared;
+}
+
+float Evaluator::Score(const BoardFeatures& features, const EvalWeights& weights)
+{
+	float score = 0;
+	for (int i = 0; i < BoardFeatures::NUM; i++)
+		score += features.value[i] * weights.weight[i];
+	return score;
+}
+
+float Evaluator::Score(const BitBoard& board, int linesCleared, const EvalWeights& weights)
+{
+	if (weights.network)
+		return weights.network->Evaluate(board) + linesCleared * weights.weight[BoardFeatures::LINES];
+	BoardFeatures features;
+	Features(board, linesCleared, features);
+	return Score(features, weights);
+}
+
+#ifdef EVALUATOR_X86
+// popcount of every byte with a 4-bit lookup table
+AVX2_TARGET static inline __m256i ByteCount(__m256i v)
+{
+	const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	__m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+	__m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+	return _mm256_add_epi8(low, high);
+}
+
+// Features for up to BATCH boards, one 16-bit lane per board
+// the playfield and the walls next to it fit in the low 16 bits of a row, which is all the features look at
+// counts are summed per byte and folded into lanes at the end, at most 8 per row over the 25 rows and the floor is 208 so a byte never overflows
+AVX2_TARGET static void FeaturesAvx2(const BitBoard* const* boards, const int* linesCleared, int count, BoardFeatures* features)
+{
+	const int BATCH = Evaluator::BATCH;
+	const int HEIGHT = BitBoard::HEIGHT;
+	// transpose so each vector holds the same row of every board, missing boards are empty
+	alignas(32) unsigned short rows[HEIGHT][BATCH];
+	for (int i = 0; i < BATCH; i++)
+		for (int y = 0; y < HEIGHT; y++)
+			rows[y][i] = (unsigned short)(i < count ? boards[i]->rows[y] : y == HEIGHT - 1 ? BitBoard::FULL_ROW : BitBoard::EMPTY_ROW);
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i field = _mm256_set1_epi16((short)BitBoard::FIELD);
+	const __m256i pairs = _mm256_set1_epi16((short)PAIRS);
+	const __m256i edges = _mm256_set1_epi16((short)EDGES);
+	__m256i covered = zero;
+	__m256i above = _mm256_set1_epi16((short)BitBoard::EMPTY_ROW);
+	__m256i maxHeight = zero;
+	__m256i wells = zero, holes = zero, height = zero, bumpiness = zero, rowTransitions = zero, columnTransitions = zero;
+	for (int y = 0; y < HEIGHT - 1; y++)
+	{
+		__m256i row = _mm256_load_si256((const __m256i*)rows[y]);
+		__m256i filled = _mm256_and_si256(row, field);
+		// rows above the stack are skipped by the scalar version, here they are masked out
+		__m256i active = _mm256_xor_si256(_mm256_cmpeq_epi16(_mm256_or_si256(covered, filled), zero), _mm256_set1_epi16(-1));
+		maxHeight = _mm256_max_epi16(maxHeight, _mm256_and_si256(active, _mm256_set1_epi16((short)(HEIGHT - 1 - y))));
+
+		__m256i sides = _mm256_and_si256(_mm256_slli_epi16(row, 1), _mm256_srli_epi16(row, 1));
+		wells = _mm256_add_epi8(wells, ByteCount(_mm256_andnot_si256(row, _mm256_andnot_si256(covered, _mm256_and_si256(sides, field)))));
+		holes = _mm256_add_epi8(holes, ByteCount(_mm256_andnot_si256(row, _mm256_and_si256(covered, field))));
+		covered = _mm256_or_si256(covered, filled);
+		height = _mm256_add_epi8(height, ByteCount(covered));
+		bumpiness = _mm256_add_epi8(bumpiness, ByteCount(_mm256_and_si256(_mm256_xor_si256(covered, _mm256_srli_epi16(covered, 1)), pairs)));
+		__m256i changes = _mm256_and_si256(_mm256_xor_si256(row, _mm256_srli_epi16(row, 1)), edges);
+		rowTransitions = _mm256_add_epi8(rowTransitions, ByteCount(_mm256_and_si256(changes, active)));
+		columnTransitions = _mm256_add_epi8(columnTransitions, ByteCount(_mm256_and_si256(_mm256_xor_si256(row, above), field)));
+		above = row;
+	}
+	__m256i floor = _mm256_load_si256((const __m256i*)rows[HEIGHT - 1]);
+	columnTransitions = _mm256_add_epi8(columnTransitions, ByteCount(_mm256_and_si256(_mm256_xor_si256(floor, above), field)));
+
+	// add the two bytes of every lane
+	const __m256i ones = _mm256_set1_epi8(1);
+	alignas(32) short sum[BoardFeatures::NUM][BATCH];
+	_mm256_store_si256((__m256i*)sum[BoardFeatures::AGGREGATE_HEIGHT], _mm256_maddubs_epi16(height, ones));
+	_mm256_store_si256((__m256i*)sum[BoardFeatures::HOLES], _mm256_maddubs_epi16(holes, ones));
+	_mm256_store_si256((__m256i*)sum[BoardFeatures::BUMPINESS], _mm256_maddubs_epi16(bumpiness, ones));
+	_mm256_store_si256((__m256i*)sum[BoardFeatures::ROW_TRANSITIONS], _mm256_maddubs_epi16(rowTransitions, ones));
+	_mm256_store_si256((__m256i*)sum[BoardFeatures::COLUMN_TRANSITIONS], _mm256_maddubs_epi16(columnTransitions, ones));
+	_mm256_store_si256((__m256i*)sum[BoardFeatures::WELLS], _mm256_maddubs_epi16(wells, ones));
+	_mm256_store_si256((__m256i*)sum[BoardFeatures::MAX_HEIGHT], maxHeight);
+	for (int i = 0; i < count; i++)
+	{
+		for (int f = 0; f < BoardFeatures::LINES; f++)
+			features[i].value[f] = sum[f][i];
+		features[i].value[BoardFeatures::LINES] = linesCleared[i];
+	}
+}
+#endif
+
+void Evaluator::FeaturesBatch(const BitBoard* const* boards, const int* linesCleared, int count, BoardFeatures* features)
+{
+	static const bool avx2 = HasAvx2();
+	for (int start = 0; start < count; start += BATCH)
+	{
+		int n = min(BATCH, count - start);
+#ifdef EVALUATOR_X86
+		if (avx2)
+		{
+			FeaturesAvx2(boards + start, linesCleared + start, n, features + start);
+			continue;
+		}
+#endif
+		for (int i = 0; i < n; i++)
+			Features(*boards[start + i], linesCleared[start + i], features[start + i]);
+	}
+}
+
+void Evaluator::ScoreBatch(const BitBoard* const* boards, const int* linesCleared, int count, const EvalWeights& weights, float* scores)
+{
+	if (weights.network)
+	{
+		weights.network->EvaluateBatch(boards, count, scores);
+		for (int i = 0; i < count; i++)
+			scores[i] += linesCleared[i] * weights.weight[BoardFeatures::LINES];
+		return;
+	}
+	BoardFeatures features[BATCH];
+	for (int start = 0; start < count; start += BATCH)
+	{
+		int n = min(BATCH, count - start);
+		FeaturesBatch(boards + start, linesCleared + start, n, features);
+		for (int i = 0; i < n; i++)
+			scores[start + i] = Score(features[i], weights);
+	}
+}
+
+bool Evaluator::HasAvx2()
+{
+#if defined(EVALUATOR_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	// the os has to save the ymm registers too
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif defined(EVALUATOR_X86)
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "BitBoard.h"
+
+class NeuralEvaluator;
+
+// classic board features used to score placements
+struct BoardFeatures
+{
+	static const int AGGREGATE_HEIGHT = 0;
+	static const int HOLES = 1;
+	static const int BUMPINESS = 2;
+	static const int ROW_TRANSITIONS = 3;
+	static const int COLUMN_TRANSITIONS = 4;
+	static const int WELLS = 5;
+	static const int MAX_HEIGHT = 6;
+	static const int LINES = 7;
+	static const int NUM = 8;
+	static const char* NAME[NUM];
+	int value[NUM];
+};
+
+struct EvalWeights
+{
+	float weight[BoardFeatures::NUM];
+	// when set, boards are scored by the network and only the LINES weight is used, see NeuralEvaluator
+	const NeuralEvaluator* network;
+	EvalWeights();
+	// hash of the weights, mixed into cache keys so scores from other weights never match
+	HashKey Key() const;
+};
+
+class Evaluator
+{
+public:
+	// boards handled per step of the batch kernel
+	static const int BATCH = 16;
+	static void Features(const BitBoard& board, int linesCleared, BoardFeatures& features);
+	static float Score(const BoardFeatures& features, const EvalWeights& weights);
+	static float Score(const BitBoard& board, int linesCleared, const EvalWeights& weights);
+	// same results as the single board versions for any number of boards, with AVX2 when the cpu has it
+	static void FeaturesBatch(const BitBoard* const* boards, const int* linesCleared, int count, BoardFeatures* features);
+	static void ScoreBatch(const BitBoard* const* boards, const int* linesCleared, int count, const EvalWeights& weights, float* scores);
+	static bool HasAvx2();
+};
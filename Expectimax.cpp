@@ -0,0 +1,171 @@
+#include "Expectimax.h"
+#include "SurfaceFit.h"
+#include <algorithm>
+
+// value of a position where the game is lost
+static const float LOSS = -1e9f;
+static const int MAX_CANDIDATES = 16;
+
+Expectimax::Expectimax(ThreadPool& threadPool) : pool(threadPool), table(TABLE_SIZE_LOG2)
+{
+	cancel = nullptr;
+	aborted = false;
+	weights = nullptr;
+	weightsKey = 0;
+	nodes = 0;
+}
+
+// deepen one piece at a time until the time is up, return the number of pieces the best move looked at
+// depth 1 is the static evaluation, the visible queue is searched exactly and chance nodes start after it
+// onDepth gets the best move of every finished depth, so a caller always has the deepest answer so far
+int Expectimax::Search(const BitBoard& board, const int* queue, int queueLength, int bag, double seconds, const EvalWeights& searchWeights, const atomic<bool>& stop, Placement& best, const function<void(const Placement&, int)>& onDepth)
+{
+	deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+	cancel = &stop;
+	aborted = false;
+	weights = &searchWeights;
+	// the settings change what a chance node is worth, so entries of other settings must not match
+	weightsKey = searchWeights.Key() ^ BitBoard::Mix(8ULL << 56 | (HashKey)candidates << 8 | (HashKey)allowTucks << 1 | (HashKey)cleanFitsOnly);
+	nodes = 0;
+	if (queueLength <= 0 || bag == 0)
+		return 0;
+
+	Placement placements[MAX_CANDIDATES];
+	BitBoard after[MAX_CANDIDATES];
+	int lines[MAX_CANDIDATES];
+	float scores[MAX_CANDIDATES];
+	int count = Candidates(board, queue[0], min(2 * candidates, MAX_CANDIDATES), placements, after, lines, scores);
+	if (count == 0)
+		return 0;
+	best = placements[0];
+
+	int completed = 1;
+	float value[MAX_CANDIDATES];
+	float lineWeight = searchWeights.weight[BoardFeatures::LINES];
+	for (int depth = 2; depth <= MAX_DEPTH; depth++)
+	{
+		pool.ParallelFor(count, [&](int i) {
+			float rest = queueLength > 1 ? Max(after[i], queue + 1, queueLength - 1, bag, depth - 1) : Chance(after[i], bag, depth - 1);
+			value[i] = lines[i] * lineWeight + rest;
+		});
+		// an unfinished depth is thrown away
+		if (aborted)
+			break;
+		int bestIndex = 0;
+		for (int i = 1; i < count; i++)
+			if (value[i] > value[bestIndex])
+				bestIndex = i;
+		best = placements[bestIndex];
+		completed = depth;
+		if (onDepth)
+			onDepth(best, depth);
+	}
+	return completed;
+}
+
+long long Expectimax::GetNodes()
+{
+	return nodes;
+}
+
+// best placement of the first piece in the queue, depth counts the pieces still to place
+float Expectimax::Max(const BitBoard& board, const int* queue, int queueLength, int bag, int depth)
+{
+	nodes += 1;
+	if (Expired())
+		return 0;
+
+	BitBoard after[MAX_CANDIDATES];
+	int lines[MAX_CANDIDATES];
+	float scores[MAX_CANDIDATES];
+	int count = Candidates(board, queue[0], depth == 1 ? 1 : candidates, nullptr, after, lines, scores);
+	if (count == 0)
+		return LOSS;
+	if (depth == 1)
+		return scores[0];
+
+	float lineWeight = weights->weight[BoardFeatures::LINES];
+	float best = LOSS;
+	for (int i = 0; i < count; i++)
+	{
+		float rest = queueLength > 1 ? Max(after[i], queue + 1, queueLength - 1, bag, depth - 1) : Chance(after[i], bag, depth - 1);
+		best = max(best, lines[i] * lineWeight + rest);
+	}
+	return best;
+}
+
+// average over every piece left in the bag, a bag that runs out is refilled
+float Expectimax::Chance(const BitBoard& board, int bag, int depth)
+{
+	HashKey key = board.hash ^ weightsKey ^ BitBoard::Mix(5ULL << 56 | (HashKey)bag << 8 | (HashKey)depth);
+	TableEntry entry;
+	if (table.Probe(key, entry))
+		return entry.value;
+
+	float sum = 0;
+	for (int type = 0; type < 7; type++)
+		if (bag & (1 << type))
+		{
+			int nextBag = bag & ~(1 << type);
+			sum += Max(board, &type, 1, nextBag ? nextBag : FULL_BAG, depth);
+		}
+	entry.value = sum / PopCount(bag);
+	entry.depth = depth;
+	if (!aborted)
+		table.Store(key, entry);
+	return entry.value;
+}
+
+// the limit best placements by static score, lines included, best first
+int Expectimax::Candidates(const BitBoard& board, int type, int limit, Placement* placements, BitBoard* after, int* lines, float* scores)
+{
+	Placement all[MoveGen::MAX_PLACEMENTS];
+	BitBoard boards[MoveGen::MAX_PLACEMENTS];
+	const BitBoard* boardPtr[MoveGen::MAX_PLACEMENTS];
+	int allLines[MoveGen::MAX_PLACEMENTS];
+	int noLines[MoveGen::MAX_PLACEMENTS] = {};
+	float allScores[MoveGen::MAX_PLACEMENTS];
+	int order[MoveGen::MAX_PLACEMENTS];
+
+	int placementNum = MoveGen::Generate(board, type, all);
+	if (cleanFitsOnly && placements == nullptr)
+		placementNum = SurfaceFit::FilterClean(board, type, all, placementNum);
+	int count = 0;
+	for (int i = 0; i < placementNum; i++)
+	{
+		if (all[i].tuck && !allowTucks)
+			continue;
+		boards[count] = board;
+		allLines[count] = boards[count].Place(type, all[i]);
+		if (boards[count].IsGameOver())
+			continue;
+		all[count] = all[i];
+		boardPtr[count] = &boards[count];
+		count += 1;
+	}
+	Evaluator::ScoreBatch(boardPtr, noLines, count, *weights, allScores);
+	for (int i = 0; i < count; i++)
+	{
+		allScores[i] += allLines[i] * weights->weight[BoardFeatures::LINES];
+		order[i] = i;
+	}
+
+	limit = min(limit, count);
+	partial_sort(order, order + limit, order + count, [&](int a, int b) { return allScores[a] > allScores[b]; });
+	for (int i = 0; i < limit; i++)
+	{
+		if (placements)
+			placements[i] = all[order[i]];
+		after[i] = boards[order[i]];
+		lines[i] = allLines[order[i]];
+		scores[i] = allScores[order[i]];
+	}
+	return limit;
+}
+
+bool Expectimax::Expired()
+{
+	if (!aborted && (*cancel || (maxNodes > 0 && nodes >= maxNodes) || chrono::steady_clock::now() >= deadline))
+		aborted = true;
+	return aborted;
+}
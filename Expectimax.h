@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include "Evaluator.h"
+#include "MoveGen.h"
+#include "ThreadPool.h"
+#include "TranspositionTable.h"
+
+// expectimax over the 7-bag, pieces past the preview are averaged over what is left in the bag
+// bag is a mask of piece types, bit t set while type t can still come before the bag is refilled
+class Expectimax
+{
+public:
+	static const int FULL_BAG = 0x7F;
+	// placements searched further at every max node, ordered by their static score
+	static const int DEFAULT_CANDIDATES = 6;
+	static const int MAX_DEPTH = 12;
+	static const int TABLE_SIZE_LOG2 = 18;
+	int candidates = DEFAULT_CANDIDATES;
+	bool allowTucks = false;
+	// below the root only placements that leave no hole are searched when there are any, see SurfaceFit
+	bool cleanFitsOnly = false;
+	// nodes per search, 0 for no limit, like the time an unfinished depth is thrown away
+	long long maxNodes = 0;
+private:
+	ThreadPool& pool;
+	// chance nodes by board, bag, depth left, weights and settings, kept between searches
+	TranspositionTable table;
+	chrono::steady_clock::time_point deadline;
+	const atomic<bool>* cancel;
+	atomic<bool> aborted;
+	const EvalWeights* weights;
+	HashKey weightsKey;
+	atomic<long long> nodes;
+public:
+	Expectimax(ThreadPool& threadPool);
+	int Search(const BitBoard& board, const int* queue, int queueLength, int bag, double seconds, const EvalWeights& searchWeights, const atomic<bool>& stop, Placement& best, const function<void(const Placement&, int)>& onDepth = nullptr);
+	long long GetNodes();
+private:
+	float Max(const BitBoard& board, const int* queue, int queueLength, int bag, int depth);
+	float Chance(const BitBoard& board, int bag, int depth);
+	int Candidates(const BitBoard& board, int type, int limit, Placement* placements, BitBoard* after, int* lines, float* scores);
+	bool Expired();
+};
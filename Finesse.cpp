@@ -0,0 +1,218 @@
+#include "Finesse.h"
+#include "MoveGen.h"
+
+static const int X_NUM = BitBoard::MAX_X - BitBoard::MIN_X + 1;
+static const int STATE_NUM = 4 * X_NUM * BitBoard::HEIGHT;
+
+// the cells a placement covers, as the first rotation with the same cells and its position
+static void Normalize(int type, int rot, int x, int y, int& canonical, int& xNorm, int& yNorm)
+{
+	int dx, dy;
+	BitBoard::CanonicalOffset(type, rot, dx, dy);
+	canonical = BitBoard::CanonicalRotation(type, rot);
+	xNorm = x + dx;
+	yNorm = y + dy;
+}
+
+static int StateIndex(int rot, int x, int y)
+{
+	return (rot * X_NUM + x - BitBoard::MIN_X) * BitBoard::HEIGHT + y;
+}
+
+// one key from (x, y, rot), false if the piece can't move, ROTATE uses the wall adjustment of Game::Rotate
+static bool Move(const BitBoard& board, int type, int key, int& x, int& y, int& rot)
+{
+	int nextX = x, nextY = y, nextRot = rot;
+	if (key == Finesse::LEFT)
+		nextX -= 1;
+	else if (key == Finesse::RIGHT)
+		nextX += 1;
+	else if (key == Finesse::DOWN)
+		nextY += 1;
+	else if (key == Finesse::ROTATE)
+	{
+		nextX = BitBoard::RotateX(type, rot, x);
+		nextRot = (rot + 1) % 4;
+	}
+	if (!board.Fits(type, nextRot, nextX, nextY))
+		return false;
+	x = nextX;
+	y = nextY;
+	rot = nextRot;
+	return true;
+}
+
+// open field paths from the spawn position, by piece, canonical rotation and normalized x
+struct FinesseTables
+{
+	int keys[7][4][X_NUM][Finesse::MAX_KEYS];
+	int keyNum[7][4][X_NUM];
+	FinesseTables();
+};
+
+// breadth first over rotate and shift on an empty board, the first path to reach a column is the shortest
+FinesseTables::FinesseTables()
+{
+	BitBoard empty;
+	for (int type = 0; type < 7; type++)
+	{
+		for (int c = 0; c < 4; c++)
+			for (int x = 0; x < X_NUM; x++)
+				keyNum[type][c][x] = 0;
+
+		int parent[4 * X_NUM];
+		int parentKey[4 * X_NUM];
+		bool seen[4 * X_NUM] = {};
+		int queue[4 * X_NUM];
+		int head = 0, tail = 0;
+		int start = MoveGen::SPAWN_X - BitBoard::MIN_X;
+		queue[tail++] = start;
+		seen[start] = true;
+		parent[start] = -1;
+		while (head < tail)
+		{
+			int state = queue[head++];
+			int rot = state / X_NUM;
+			int x = state % X_NUM + BitBoard::MIN_X;
+
+			int canonical, xNorm, yNorm;
+			Normalize(type, rot, x, MoveGen::SPAWN_Y, canonical, xNorm, yNorm);
+			int& num = keyNum[type][canonical][xNorm - BitBoard::MIN_X];
+			if (num == 0)
+			{
+				int path[Finesse::MAX_KEYS];
+				int length = 0;
+				for (int s = state; parent[s] >= 0; s = parent[s])
+					path[length++] = parentKey[s];
+				for (int i = 0; i < length; i++)
+					keys[type][canonical][xNorm - BitBoard::MIN_X][i] = path[length - 1 - i];
+				keys[type][canonical][xNorm - BitBoard::MIN_X][length] = Finesse::DROP;
+				num = length + 1;
+			}
+
+			for (int key = Finesse::LEFT; key <= Finesse::ROTATE; key++)
+			{
+				int nextX = x, nextY = MoveGen::SPAWN_Y, nextRot = rot;
+				if (!Move(empty, type, key, nextX, nextY, nextRot))
+					continue;
+				int next = nextRot * X_NUM + nextX - BitBoard::MIN_X;
+				if (seen[next])
+					continue;
+				seen[next] = true;
+				parent[next] = state;
+				parentKey[next] = key;
+				queue[tail++] = next;
+			}
+		}
+	}
+}
+
+// built on first use, the piece tables need Game::PIECE
+static const FinesseTables& Tables()
+{
+	static FinesseTables tables;
+	return tables;
+}
+
+// keys from (xPos, yPos, rot) to target, written to keys, return how many or 0 if it can't be reached
+// a piece at the spawn position and rotation tries the open field table first
+int Finesse::FindPath(const BitBoard& board, int type, int xPos, int yPos, int rot, const Placement& target, int* keys)
+{
+	if (xPos == MoveGen::SPAWN_X && rot == 0)
+	{
+		int canonical, xNorm, yNorm;
+		Normalize(type, target.rotation, target.x, target.y, canonical, xNorm, yNorm);
+		if (xNorm >= BitBoard::MIN_X && xNorm <= BitBoard::MAX_X)
+		{
+			const int* path = Tables().keys[type][canonical][xNorm - BitBoard::MIN_X];
+			int keyNum = Tables().keyNum[type][canonical][xNorm - BitBoard::MIN_X];
+			if (keyNum > 0 && Replay(board, type, xPos, yPos, rot, path, keyNum, target))
+			{
+				for (int i = 0; i < keyNum; i++)
+					keys[i] = path[i];
+				return keyNum;
+			}
+		}
+	}
+	return SearchPath(board, type, xPos, yPos, rot, target, keys);
+}
+
+// breadth first search over every key, for targets under overhangs or a piece that has already fallen
+int Finesse::SearchPath(const BitBoard& board, int type, int xPos, int yPos, int rot, const Placement& target, int* keys)
+{
+	if (!board.Fits(type, rot, xPos, yPos))
+		return 0;
+	int targetRot, targetX, targetY;
+	Normalize(type, target.rotation, target.x, target.y, targetRot, targetX, targetY);
+
+	static thread_local int parent[STATE_NUM];
+	static thread_local int parentKey[STATE_NUM];
+	static thread_local int visit[STATE_NUM];
+	static thread_local int queue[STATE_NUM];
+	// marks visited states by search number, so the arrays are never cleared
+	static thread_local int searchNum = 0;
+	searchNum += 1;
+
+	int head = 0, tail = 0;
+	int start = StateIndex(rot, xPos, yPos);
+	queue[tail++] = start;
+	visit[start] = searchNum;
+	parent[start] = -1;
+	while (head < tail)
+	{
+		int state = queue[head++];
+		int y = state % BitBoard::HEIGHT;
+		int x = state / BitBoard::HEIGHT % X_NUM + BitBoard::MIN_X;
+		int r = state / BitBoard::HEIGHT / X_NUM;
+
+		int canonical, xNorm, yNorm;
+		Normalize(type, r, x, board.Drop(type, r, x, y), canonical, xNorm, yNorm);
+		if (canonical == targetRot && xNorm == targetX && yNorm == targetY)
+		{
+			int length = 0;
+			for (int s = state; parent[s] >= 0; s = parent[s])
+				length += 1;
+			if (length + 1 > MAX_KEYS)
+				return 0;
+			int i = length;
+			keys[i] = DROP;
+			for (int s = state; parent[s] >= 0; s = parent[s])
+				keys[--i] = parentKey[s];
+			return length + 1;
+		}
+
+		for (int key = LEFT; key <= DOWN; key++)
+		{
+			int nextX = x, nextY = y, nextRot = r;
+			if (!Move(board, type, key, nextX, nextY, nextRot))
+				continue;
+			int next = StateIndex(nextRot, nextX, nextY);
+			if (visit[next] == searchNum)
+				continue;
+			visit[next] = searchNum;
+			parent[next] = state;
+			parentKey[next] = key;
+			queue[tail++] = next;
+		}
+	}
+	return 0;
+}
+
+void Finesse::InitTables()
+{
+	Tables();
+}
+
+// true if the keys move the piece to target on this board
+bool Finesse::Replay(const BitBoard& board, int type, int xPos, int yPos, int rot, const int* keys, int keyNum, const Placement& target)
+{
+	if (!board.Fits(type, rot, xPos, yPos))
+		return false;
+	for (int i = 0; i < keyNum && keys[i] != DROP; i++)
+		if (!Move(board, type, keys[i], xPos, yPos, rot))
+			return false;
+	int canonical, xNorm, yNorm, targetRot, targetX, targetY;
+	Normalize(type, rot, xPos, board.Drop(type, rot, xPos, yPos), canonical, xNorm, yNorm);
+	Normalize(type, target.rotation, target.x, target.y, targetRot, targetX, targetY);
+	return canonical == targetRot && xNorm == targetX && yNorm == targetY;
+}
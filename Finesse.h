@@ -0,0 +1,21 @@
+#pragma once
+#include "BitBoard.h"
+
+// shortest key sequences that bring a piece to a placement with the moves of Game::Run
+// every sequence ends with DROP, which hard drops and locks the piece
+class Finesse
+{
+public:
+	static const int LEFT = 0;
+	static const int RIGHT = 1;
+	static const int ROTATE = 2;
+	static const int DOWN = 3;
+	static const int DROP = 4;
+	// soft dropping to the floor alone takes HEIGHT keys
+	static const int MAX_KEYS = 64;
+	static int FindPath(const BitBoard& board, int type, int xPos, int yPos, int rot, const Placement& target, int* keys);
+	static int SearchPath(const BitBoard& board, int type, int xPos, int yPos, int rot, const Placement& target, int* keys);
+	static void InitTables();
+private:
+	static bool Replay(const BitBoard& board, int type, int xPos, int yPos, int rot, const int* keys, int keyNum, const Placement& target);
+};
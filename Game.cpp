@@ -1,4 +1,8 @@
 #include "Game.h"
+#include "Bot.h"
+#include "HeadlessGame.h"
+#include "Finesse.h"
+#include "OpeningBook.h"
 
 Color::Color()
 {
@@ -28,6 +32,13 @@ Piece::Piece(string s, Color c)
 	color = c;
 }
 
+Piece::Piece(string s, Color c, int t)
+{
+	shape = s;
+	color = c;
+	type = t;
+}
+
 bool Piece::IsEmpty()
 {
 	return shape.empty();
@@ -55,15 +66,28 @@ const Color Game::COLOR[7] = {
 };
 
 // Constructor
-Game::Game()
+Game::Game(bool terminalOnly)
 {
+	botLevel = Bot::DEFAULT_LEVEL;
+	terminalView = terminalOnly;
+
+	// the terminal needs no window, audio or font, only timers and the event queue keys go through
+	if (terminalView)
+	{
+		if (SDL_Init(SDL_INIT_TIMER | SDL_INIT_EVENTS) < 0)
+			cout << "Failed to initialize SDL. SDL Errors: " << SDL_GetError() << endl;
+		InitGameData();
+		srand(time(NULL));
+		return;
+	}
+
 	// inititialize SDL
 	if (SDL_Init(SDL_INIT_EVERYTHING) < 0)
 		cout << "Failed to initialize SDL. SDL Errors: " << SDL_GetError() << endl;
 	else
 	{
 		// create window
-		window = SDL_CreateWindow("Tetris", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+		window = SDL_CreateWindow("Tetris", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
 		if (window == NULL)
 			cout << "Failed to initialize window. SDL Errors: " << SDL_GetError() << endl;
 		else
@@ -90,11 +114,14 @@ Game::Game()
 		cout << "Fail to initialize TTF. TTF Errors: " << TTF_GetError() << endl;
 	else
 	{
-		font = TTF_OpenFont("./score.ttf", 30);
+		font = TTF_OpenFont("./score.ttf", FONT_SIZE);
 		if (font == NULL)
 			cout << "Fail to load score font. TTF Errors: " << TTF_GetError() << endl;
 	}
 
+	if (renderer != NULL && font != NULL)
+		UpdateLayout();
+
 	InitGameData();
 
 	srand(time(NULL));
@@ -103,6 +130,14 @@ Game::Game()
 // Destructor
 Game::~Game()
 {
+	delete bot;
+	bot = nullptr;
+	delete botMove;
+	botMove = nullptr;
+	delete book;
+	book = nullptr;
+	overlay.Free();
+	FreeTextures();
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
 	TTF_CloseFont(font);
@@ -124,6 +159,8 @@ Game::~Game()
 // check if the constructor init everything successfully
 bool Game::InitSuccess()
 {
+	if (terminalView)
+		return SDL_WasInit(SDL_INIT_EVENTS) != 0;
 	if (renderer == NULL || window == NULL || font == NULL || bgm == NULL)
 		return false;
 	return true;
@@ -135,6 +172,7 @@ void Game::InitGameData()
 	level = 0;
 	clearLinesNum = 0;
 	framePerGridCell = MAX_DROP_RATE - level * DECREASE_RATE;
+	particles.Clear();
 
 	InitGameBoard();
 
@@ -143,12 +181,17 @@ void Game::InitGameData()
 
 void Game::InitGameBoard()
 {
+	boardHash = 0;
 	for (int y = 0; y < GAMEBOARD_HEIGHT; y++)
+	{
+		rowOffset[y] = 0;
+		prevRowOffset[y] = 0;
 		for (int x = 0; x < GAMEBOARD_WIDTH; x++)
 		{
 			gameboard[y * GAMEBOARD_WIDTH + x] = (x == 0 || x == GAMEBOARD_WIDTH - 1 || y == GAMEBOARD_HEIGHT - 1) ? 'o' : (y == 4)? '-': '.';
 			colorBoard[y * GAMEBOARD_WIDTH + x] = (x == 0 || x == GAMEBOARD_WIDTH - 1 || y == GAMEBOARD_HEIGHT - 1) ? Color(128, 128, 128, 255) : Color(0, 0, 0, 255);
 		}
+	}
 }
 
 void Game::GetNextOrder()
@@ -164,7 +207,7 @@ void Game::GetNextOrder()
 }
 
 // draw the generated piece
-void Game::DrawPiece(int xPos, int yPos)
+void Game::DrawPiece(float xPos, float yPos)
 {
 	for (int y = 0; y < 4; y++)
 		for (int x = 0; x < 4; x++)
@@ -172,20 +215,170 @@ void Game::DrawPiece(int xPos, int yPos)
 				DrawPieceRect(currPiece.color, xPos + x, yPos + y);
 }
 
-void Game::DrawPieceRect(Color& color, int xPos, int yPos)
+// position is in cells and may be fractional while the piece is moving between ticks
+void Game::DrawPieceRect(Color& color, float xPos, float yPos)
+{
+	DrawBlock(color, offsetX + xPos * cellSize, offsetY + (yPos - BUFFER_HEIGHT) * cellSize);
+}
+
+// draw one cell at a pixel position, copied from the block atlas when the color is in it
+void Game::DrawBlock(Color& color, float xPixel, float yPixel)
 {
+	int block = FindBlock(color);
+	if (blockAtlas && block >= 0)
+	{
+		SDL_Rect src{ block * cellSize, 0, cellSize, cellSize };
+		SDL_FRect dst{ xPixel, yPixel, (float)cellSize, (float)cellSize };
+		SDL_RenderCopyF(renderer, blockAtlas, &src, &dst);
+		overlay.CountDrawCall();
+		return;
+	}
+
+	int borderSize = max(1, cellSize / 15);
 	SDL_SetRenderDrawColor(renderer, color.r / 2, color.g / 2, color.b / 2, 255);
-	SDL_Rect border{ xPos * CELL_SIZE, (yPos - BUFFER_HEIGHT) * CELL_SIZE, CELL_SIZE, CELL_SIZE };
-	SDL_RenderFillRect(renderer, &border);
+	SDL_FRect border{ xPixel, yPixel, (float)cellSize, (float)cellSize };
+	SDL_RenderFillRectF(renderer, &border);
 
 	SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-	SDL_Rect pieceRect{ xPos * CELL_SIZE + 2, (yPos - BUFFER_HEIGHT) * CELL_SIZE + 2, CELL_SIZE - 4, CELL_SIZE - 4 };
-	SDL_RenderFillRect(renderer, &pieceRect);
+	SDL_FRect pieceRect{ xPixel + borderSize, yPixel + borderSize, (float)(cellSize - 2 * borderSize), (float)(cellSize - 2 * borderSize) };
+	SDL_RenderFillRectF(renderer, &pieceRect);
+	overlay.CountDrawCall(2);
+}
+
+// draw text stretched into rect, the texture is only rasterized again when the text changes
+void Game::DrawText(int slot, const string& text, SDL_Rect& rect)
+{
+	if (textTexture[slot] == nullptr || textString[slot] != text)
+	{
+		if (textTexture[slot])
+			SDL_DestroyTexture(textTexture[slot]);
+		screen = TTF_RenderText_Solid(font, text.c_str(), { 255, 255, 255 });
+		textTexture[slot] = SDL_CreateTextureFromSurface(renderer, screen);
+		textString[slot] = text;
+		SDL_FreeSurface(screen);
+		screen = nullptr;
+		overlay.CountTexture();
+	}
+	SDL_RenderCopy(renderer, textTexture[slot], NULL, &rect);
+	overlay.CountDrawCall();
+}
+
+// fit the WINDOW_WIDTH x WINDOW_HEIGHT layout into the output and rebuild the size dependent assets
+void Game::UpdateLayout()
+{
+	int width, height;
+	SDL_GetRendererOutputSize(renderer, &width, &height);
+	scale = min((float)width / WINDOW_WIDTH, (float)height / WINDOW_HEIGHT);
+	cellSize = max(1, (int)(CELL_SIZE * scale));
+	offsetX = (width - (int)(WINDOW_WIDTH * scale)) / 2;
+	offsetY = (height - (int)(WINDOW_HEIGHT * scale)) / 2;
+
+	// rasterize the font at the pixel size it is drawn at
+	int newFontSize = max(8, (int)(FONT_SIZE * scale));
+	if (newFontSize != fontSize)
+	{
+		TTF_Font* newFont = TTF_OpenFont("./score.ttf", newFontSize);
+		if (newFont == NULL)
+			cout << "Fail to resize score font. TTF Errors: " << TTF_GetError() << endl;
+		else
+		{
+			TTF_CloseFont(font);
+			font = newFont;
+			fontSize = newFontSize;
+		}
+	}
+
+	FreeTextures();
+	overlay.Free();
+	BuildBlockAtlas();
+}
+
+void Game::BuildBlockAtlas()
+{
+	// without render targets every cell is drawn with fills instead
+	if (!SDL_RenderTargetSupported(renderer))
+		return;
+	blockAtlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, cellSize * (WALL_BLOCK + 1), cellSize);
+	if (blockAtlas == NULL)
+		return;
+
+	SDL_SetRenderTarget(renderer, blockAtlas);
+	int borderSize = max(1, cellSize / 15);
+	for (int i = 0; i <= WALL_BLOCK; i++)
+	{
+		Color color = i == WALL_BLOCK ? Color(128, 128, 128, 255) : COLOR[i];
+		SDL_SetRenderDrawColor(renderer, color.r / 2, color.g / 2, color.b / 2, 255);
+		SDL_Rect border{ i * cellSize, 0, cellSize, cellSize };
+		SDL_RenderFillRect(renderer, &border);
+
+		SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+		SDL_Rect pieceRect{ i * cellSize + borderSize, borderSize, cellSize - 2 * borderSize, cellSize - 2 * borderSize };
+		SDL_RenderFillRect(renderer, &pieceRect);
+	}
+	SDL_SetRenderTarget(renderer, NULL);
+}
+
+void Game::FreeTextures()
+{
+	for (int i = 0; i < TEXT_NUM; i++)
+		if (textTexture[i])
+		{
+			SDL_DestroyTexture(textTexture[i]);
+			textTexture[i] = nullptr;
+		}
+	if (blockAtlas)
+	{
+		SDL_DestroyTexture(blockAtlas);
+		blockAtlas = nullptr;
+	}
+}
+
+// index of the color in the block atlas, -1 if it isn't there
+int Game::FindBlock(Color& color)
+{
+	for (int i = 0; i < 7; i++)
+		if (COLOR[i].r == color.r && COLOR[i].g == color.g && COLOR[i].b == color.b && COLOR[i].a == color.a)
+			return i;
+	if (color.r == 128 && color.g == 128 && color.b == 128)
+		return WALL_BLOCK;
+	return -1;
+}
+
+// map a rect in the WINDOW_WIDTH x WINDOW_HEIGHT layout to output pixels
+SDL_Rect Game::ToScreen(int x, int y, int w, int h)
+{
+	return { offsetX + (int)(x * scale), offsetY + (int)(y * scale), (int)(w * scale), (int)(h * scale) };
+}
+
+// mouse position in output pixels, which differ from window coordinates on high dpi displays
+void Game::GetMousePosition(int& x, int& y)
+{
+	int windowWidth, windowHeight, outputWidth, outputHeight;
+	SDL_GetMouseState(&x, &y);
+	SDL_GetWindowSize(window, &windowWidth, &windowHeight);
+	SDL_GetRendererOutputSize(renderer, &outputWidth, &outputHeight);
+	if (windowWidth > 0 && windowHeight > 0)
+	{
+		x = x * outputWidth / windowWidth;
+		y = y * outputHeight / windowHeight;
+	}
+}
+
+void Game::HandleWindowEvent(SDL_Event& e)
+{
+	if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+		UpdateLayout();
+	// render target contents are lost with the device
+	else if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET)
+		UpdateLayout();
 }
 
 // update screen
 void Game::Update(int xPos, int yPos)
 {
+	for (int y = 0; y < 4; y++)
+		if (y + yPos >= 0 && y + yPos < GAMEBOARD_HEIGHT)
+			boardHash ^= HashRow(y + yPos);
 	for (int y = 0; y < 4; y++)
 		for (int x = 0; x < 4; x++)
 			if (currPiece.shape[y * 4 + x] == 'x')
@@ -193,20 +386,32 @@ void Game::Update(int xPos, int yPos)
 				gameboard[(y + yPos) * GAMEBOARD_WIDTH + (x + xPos)] = 'x';
 				colorBoard[(y + yPos) * GAMEBOARD_WIDTH + (x + xPos)] = currPiece.color;
 			}
+	for (int y = 0; y < 4; y++)
+		if (y + yPos >= 0 && y + yPos < GAMEBOARD_HEIGHT)
+			boardHash ^= HashRow(y + yPos);
 				
 	PrintMap();
 }
 
-void Game::DrawGameboard()
+void Game::DrawGameboard(float alpha)
 {
 	for (int y = 0; y < GAMEBOARD_HEIGHT; y++)
+	{
+		// rows above a cleared line are still collapsing into place
+		float offset = prevRowOffset[y] + (rowOffset[y] - prevRowOffset[y]) * alpha;
 		for (int x = 0; x < GAMEBOARD_WIDTH; x++)
-			if (gameboard[y * GAMEBOARD_WIDTH + x] == 'x' || gameboard[y * GAMEBOARD_WIDTH + x] == 'o')
-				DrawPieceRect(colorBoard[y * GAMEBOARD_WIDTH + x], x, y);
+			if (gameboard[y * GAMEBOARD_WIDTH + x] == 'x')
+				DrawPieceRect(colorBoard[y * GAMEBOARD_WIDTH + x], (float)x, y - offset);
+			else if (gameboard[y * GAMEBOARD_WIDTH + x] == 'o')
+				DrawPieceRect(colorBoard[y * GAMEBOARD_WIDTH + x], (float)x, (float)y);
+	}
 }
 
 void Game::PrintMap()
 {
+	// the terminal view owns stdout
+	if (terminalView)
+		return;
 	cout << "Map: " << endl;
 	for (int y = 0; y < GAMEBOARD_HEIGHT; y++)
 	{
@@ -216,6 +421,171 @@ void Game::PrintMap()
 	}
 }
 
+// draw the gameboard and current piece into the terminal, only changed cells are written
+void Game::DrawTerminal(int xPos, int yPos)
+{
+	char cells[GAMEBOARD_WIDTH * GAMEBOARD_HEIGHT];
+	Color colors[GAMEBOARD_WIDTH * GAMEBOARD_HEIGHT];
+	copy(gameboard, gameboard + GAMEBOARD_WIDTH * GAMEBOARD_HEIGHT, cells);
+	copy(colorBoard, colorBoard + GAMEBOARD_WIDTH * GAMEBOARD_HEIGHT, colors);
+
+	for (int y = 0; y < 4; y++)
+		for (int x = 0; x < 4; x++)
+			if (currPiece.shape[y * 4 + x] == 'x' && yPos + y >= 0 && yPos + y < GAMEBOARD_HEIGHT)
+			{
+				cells[(y + yPos) * GAMEBOARD_WIDTH + (x + xPos)] = 'x';
+				colors[(y + yPos) * GAMEBOARD_WIDTH + (x + xPos)] = currPiece.color;
+			}
+
+	string status = "Scores: " + to_string(scores) + "  Level: " + to_string(level);
+	terminal.Draw(cells, colors, GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT, BUFFER_HEIGHT, status);
+}
+
+void Game::SetAutoplay(bool enable)
+{
+	autoplay = enable;
+	if (autoplay && bot == nullptr)
+	{
+		bot = new Bot();
+		botMove = new Placement();
+		bot->SetLevel(botLevel);
+		if (!networkPath.empty() && !bot->LoadNetwork(networkPath))
+			cout << "Failed to load network " << networkPath << endl;
+	}
+	botRequested = false;
+	botPlanned = false;
+}
+
+// the bot scores boards with this network file, set before autoplay starts
+void Game::SetNetwork(const string& path)
+{
+	networkPath = path;
+}
+
+// strength of autoplay, see Bot::LEVEL
+void Game::SetBotLevel(int level)
+{
+	botLevel = max(0, min(Bot::LEVELS - 1, level));
+	if (bot)
+		bot->SetLevel(botLevel);
+}
+
+// the bot plays the first bag from this book, see OpeningBook
+bool Game::SetBook(const string& path)
+{
+	if (book == nullptr)
+		book = new OpeningBook();
+	return book->Open(path);
+}
+
+// ask the bot for the current piece, then replay its move one key per frame through the event queue
+void Game::UpdateAutoplay(int xPos, int yPos)
+{
+	if (!autoplay || bot == nullptr)
+		return;
+
+	if (!botRequested && book != nullptr && book->Lookup(GetBitBoard(), opening.data(), (int)opening.size(), *botMove))
+	{
+		botRequested = true;
+		botPlanned = true;
+		botHasMove = true;
+	}
+
+	if (!botRequested)
+	{
+		// a level that doesn't search still gets the shortest wait for its static move
+		int think = min(GetThinkMillisecond(yPos), max(Bot::LEVEL[botLevel].thinkMillisecond, Bot::MIN_THINK_MILLISECOND));
+		bot->Request(GetBitBoard(), currPiece.type, nextPiece.type, GetBagMask(), think);
+		botDeadline = SDL_GetTicks() + think;
+		botRequested = true;
+		botPlanned = false;
+	}
+
+	// never wait for the bot, past the deadline take whatever it has
+	if (!botPlanned && (bot->IsDone() || SDL_GetTicks() >= botDeadline))
+	{
+		bot->Cancel();
+		botHasMove = bot->GetBest(*botMove);
+		botPlanned = true;
+	}
+
+	// the path is found again from where the piece is every frame, so a row lost to gravity can't throw it off
+	// slower levels press a key every 1000 / actionsPerSecond milliseconds and do nothing in between
+	int actionsPerSecond = Bot::LEVEL[botLevel].actionsPerSecond;
+	if (botPlanned && actionsPerSecond > 0 && SDL_GetTicks() < botNextAction)
+		return;
+	if (botPlanned)
+	{
+		botNextAction = SDL_GetTicks() + (actionsPerSecond > 0 ? 1000 / actionsPerSecond : 0);
+		botKeys.clear();
+		if (botHasMove)
+			PlanKeys(*botMove, xPos, yPos);
+		if (botKeys.empty())
+			botKeys.push_back(SDLK_SPACE);
+		SDL_Event key{};
+		key.type = SDL_KEYDOWN;
+		key.key.keysym.sym = botKeys[0];
+		SDL_PushEvent(&key);
+	}
+}
+
+// the shortest keys from the current position to move, soft drops and tucks included, nothing if it can't be reached
+void Game::PlanKeys(Placement& move, int xPos, int yPos)
+{
+	static const SDL_Keycode KEYCODES[] = { SDLK_LEFT, SDLK_RIGHT, SDLK_UP, SDLK_DOWN, SDLK_SPACE };
+	int keys[Finesse::MAX_KEYS];
+	int keyNum = Finesse::FindPath(GetBitBoard(), currPiece.type, xPos, yPos, currPiece.rotation, move, keys);
+	for (int i = 0; i < keyNum; i++)
+		botKeys.push_back(KEYCODES[keys[i]]);
+}
+
+BitBoard Game::GetBitBoard()
+{
+	// the hash kept by Update and ClearLine saves hashing every row again
+	BitBoard board;
+	board.FromGameboard(gameboard, boardHash);
+	SDL_assert([&] { BitBoard check = board; check.Rehash(); return check.hash == boardHash; }());
+	return board;
+}
+
+// pieces left in the bag after nextPiece, an empty bag is refilled with every piece by GetNextOrder
+int Game::GetBagMask()
+{
+	int mask = 0;
+	for (int n : index)
+		mask |= 1 << n;
+	return mask ? mask : 0x7F;
+}
+
+// time the bot gets for the current piece: the frames it falls before its box reaches the stack,
+// plus the lock delay, less the frames its keys take, so it shrinks with framePerGridCell at high levels
+int Game::GetThinkMillisecond(int yPos)
+{
+	int stackTop = GAMEBOARD_HEIGHT - 1;
+	for (int y = 0; y < GAMEBOARD_HEIGHT - 1 && stackTop == GAMEBOARD_HEIGHT - 1; y++)
+		for (int x = 1; x < GAMEBOARD_WIDTH - 1; x++)
+			if (gameboard[y * GAMEBOARD_WIDTH + x] == 'x')
+			{
+				stackTop = y;
+				break;
+			}
+	int freeRows = max(0, stackTop - (yPos + 4));
+	int frames = freeRows * framePerGridCell + LOCKDELAYFRAME - Bot::KEY_FRAMES;
+	return min(max(frames * 1000 / FPS, Bot::MIN_THINK_MILLISECOND), Bot::MAX_THINK_MILLISECOND);
+}
+
+// hash of one gameboard row, the walls and the floor are left out like in BitBoard
+unsigned long long Game::HashRow(int y)
+{
+	if (y == GAMEBOARD_HEIGHT - 1)
+		return 0;
+	RowMask row = 0;
+	for (int x = 1; x < GAMEBOARD_WIDTH - 1; x++)
+		if (gameboard[y * GAMEBOARD_WIDTH + x] == 'x')
+			row |= 1u << (x + BitBoard::PAD);
+	return BitBoard::HashRow(row, y);
+}
+
 // get new piece
 void Game::GetNewPiece()
 {
@@ -230,7 +600,8 @@ void Game::GetNewPiece()
 		// get current piece
 		n = index.back();
 		index.pop_back();
-		currPiece = { PIECE[n], COLOR[n] };
+		currPiece = { PIECE[n], COLOR[n], n };
+		opening.push_back(n);
 	}
 	else
 		currPiece = nextPiece;
@@ -238,7 +609,10 @@ void Game::GetNewPiece()
 	// get new piece
 	n = index.back();
 	index.pop_back();
-	nextPiece = { PIECE[n], COLOR[n] };
+	nextPiece = { PIECE[n], COLOR[n], n };
+	// only the first game starts on a fresh bag, a new game keeps the pieces already drawn
+	if (!opening.empty() && (int)opening.size() <= OpeningBook::PIECES)
+		opening.push_back(n);
 }
 
 // rotate piece
@@ -258,6 +632,7 @@ void Game::Rotate(int& xPos, int yPos)
 	if (IsValidPosition(rotatedPiece, tempXPos, yPos))
 	{
 		currPiece.shape = rotatedPiece;
+		currPiece.rotation = (currPiece.rotation + 1) % 4;
 		xPos = tempXPos;
 	}
 }
@@ -281,6 +656,8 @@ void Game::CheckLine(int yLine)
 		// current line  = previous line
 		if (isLineFinished)
 		{
+			for (int x = 1; x < GAMEBOARD_WIDTH - 1; x++)
+				particles.Emit((float)x, (float)(yLine + y), 3, colorBoard[(yLine + y) * GAMEBOARD_WIDTH + x], 6.0f);
 			ClearLine(yLine + y);
 			linesNum += 1;
 		}
@@ -291,11 +668,18 @@ void Game::CheckLine(int yLine)
 void Game::ClearLine(int yLine)
 {
 	for (int y = yLine; y > 0; y--)
+	{
+		// the moved row is drawn one more cell above its new position and collapses over the next ticks
+		rowOffset[y] = rowOffset[y - 1] + 1;
+		prevRowOffset[y] = prevRowOffset[y - 1] + 1;
+		boardHash ^= HashRow(y);
 		for (int x = 0; x < GAMEBOARD_WIDTH; x++)
 		{
 			gameboard[y * GAMEBOARD_WIDTH + x] = gameboard[(y - 1) * GAMEBOARD_WIDTH + x];
 			colorBoard[y * GAMEBOARD_WIDTH + x] = colorBoard[(y - 1) * GAMEBOARD_WIDTH + x];
 		}
+		boardHash ^= HashRow(y);
+	}
 }
 
 void Game::HardDrop(int xPos, int& yPos)
@@ -313,49 +697,36 @@ void Game::HardDrop(int xPos, int& yPos)
 	yPos = lowestY;
 }
 
+// kick up particles below the lowest cell of each column of the dropped piece
+void Game::EmitDropDust(int xPos, int yPos)
+{
+	for (int x = 0; x < 4; x++)
+		for (int y = 3; y >= 0; y--)
+			if (currPiece.shape[y * 4 + x] == 'x')
+			{
+				particles.Emit((float)(xPos + x), yPos + y + 0.5f, 2, currPiece.color, 3.0f);
+				break;
+			}
+}
+
 void Game::AddScore(int rowClear)
 {
 	clearLinesNum += rowClear;
+	scores += HeadlessGame::LineScore(rowClear, IsPerfectClear(), level);
 	if (IsPerfectClear())
-		scores = scores + 800 * (level + 1);
-	else
-		switch (rowClear)
-		{
-		case 1:
-			scores = scores + 40 * (level + 1);
-			break;
-		case 2:
-			scores = scores + 100 * (level + 1);
-			break;
-		case 3:
-			scores = scores + 300 * (level + 1);
-			break;
-		case 4:
-			scores = scores + 1200 * (level + 1);
-			break;
-		}
+		for (int x = 1; x < GAMEBOARD_WIDTH - 1; x++)
+			particles.Emit((float)x, (float)(GAMEBOARD_HEIGHT - 2), 12, Color(255, 255, 255, 255), 12.0f);
 	// increase level
 	if (clearLinesNum >= 10 * (level + 1))
 	{
-		cout << "level " << level << " -> level " << level + 1 << endl;
+		if (!terminalView)
+			cout << "level " << level << " -> level " << level + 1 << endl;
 		level += 1;
-		if (level < 9)
-			framePerGridCell = MAX_DROP_RATE - level * DECREASE_RATE;
-		else if (level == 9)
-			framePerGridCell = 6;
-		else if (level >= 10 && level <= 12)
-			framePerGridCell = 5;
-		else if (level >= 13 && level <= 15)
-			framePerGridCell = 4;
-		else if (level >= 16 && level <= 18)
-			framePerGridCell = 3;
-		else if (level >= 19 && level <= 28)
-			framePerGridCell = 2;
-		else
-			framePerGridCell = 1;
+		framePerGridCell = HeadlessGame::FramePerGridCell(level);
 	}
 
-	cout << "Scores: " << scores << endl;
+	if (!terminalView)
+		cout << "Scores: " << scores << endl;
 }
 
 void Game::DrawLowestPos(int xPos, int yPos)
@@ -376,108 +747,60 @@ void Game::DrawLowestPos(int xPos, int yPos)
 			if (currPiece.shape[y * 4 + x] == 'x')
 			{
 				SDL_SetRenderDrawColor(renderer, currPiece.color.r, currPiece.color.g, currPiece.color.b, currPiece.color.a);
-				SDL_Rect pieceRect{ (xPos + x) * CELL_SIZE, (lowestY - BUFFER_HEIGHT + y) * CELL_SIZE, CELL_SIZE, CELL_SIZE };
+				SDL_Rect pieceRect{ offsetX + (xPos + x) * cellSize, offsetY + (lowestY - BUFFER_HEIGHT + y) * cellSize, cellSize, cellSize };
 				SDL_RenderDrawRect(renderer, &pieceRect);
+				overlay.CountDrawCall();
 			}
 }
 
 void Game::DrawNextPiece()
 {
-	/*DrawPieceRect(nextPiece.color, 15 + x, 8 + y);*/
+	SDL_Rect nextRect = ToScreen(WINDOW_WIDTH * 5 / 8, WINDOW_HEIGHT * 4 / 8, 0, 0);
 	for (int y = 0; y < 4; y++)
 		for (int x = 0; x < 4; x++)
 			if (nextPiece.shape[y * 4 + x] == 'x')
-			{
-				SDL_SetRenderDrawColor(renderer, nextPiece.color.r / 2, nextPiece.color.g / 2, nextPiece.color.b / 2, 255);
-				SDL_Rect border{ WINDOW_WIDTH * 5 / 8 + x * CELL_SIZE, WINDOW_HEIGHT * 4 / 8 + y * CELL_SIZE, CELL_SIZE, CELL_SIZE };
-				SDL_RenderFillRect(renderer, &border);
-
-				SDL_SetRenderDrawColor(renderer, nextPiece.color.r, nextPiece.color.g, nextPiece.color.b, nextPiece.color.a);
-				SDL_Rect pieceRect{ WINDOW_WIDTH * 5 / 8 + x * CELL_SIZE + 2, WINDOW_HEIGHT * 4 / 8 + y * CELL_SIZE + 2, CELL_SIZE - 4, CELL_SIZE - 4 };
-				SDL_RenderFillRect(renderer, &pieceRect);
-			}
-				
+				DrawBlock(nextPiece.color, (float)(nextRect.x + x * cellSize), (float)(nextRect.y + y * cellSize));
 }
 
 void Game::DrawScore()
 {
-	string text = "Scores: " + to_string(scores);
-	screen = TTF_RenderText_Solid(font, text.c_str(), { 255, 255, 255 });
-	SDL_Texture* scoreText = SDL_CreateTextureFromSurface(renderer, screen);
-	SDL_Rect scoreRect{ WINDOW_WIDTH * 5 / 8, 0, WINDOW_WIDTH / 4, WINDOW_HEIGHT / 8 };
-	SDL_RenderCopy(renderer, scoreText, NULL, &scoreRect);
-	SDL_DestroyTexture(scoreText);
-	SDL_FreeSurface(screen);
-	screen = nullptr;
+	SDL_Rect scoreRect = ToScreen(WINDOW_WIDTH * 5 / 8, 0, WINDOW_WIDTH / 4, WINDOW_HEIGHT / 8);
+	DrawText(TEXT_SCORE, "Scores: " + to_string(scores), scoreRect);
 }
 
 void Game::DrawLevel()
 {
-	string text = "Level: " + to_string(level);
-	screen = TTF_RenderText_Solid(font, text.c_str(), { 255, 255, 255 });
-	SDL_Texture* levelText = SDL_CreateTextureFromSurface(renderer, screen);
-	SDL_Rect levelRect{ WINDOW_WIDTH * 5 / 8, WINDOW_HEIGHT * 2 / 8, WINDOW_WIDTH / 4, WINDOW_HEIGHT / 8 };
-	SDL_RenderCopy(renderer, levelText, NULL, &levelRect);
-	SDL_DestroyTexture(levelText);
-	SDL_FreeSurface(screen);
-	screen = nullptr;
+	SDL_Rect levelRect = ToScreen(WINDOW_WIDTH * 5 / 8, WINDOW_HEIGHT * 2 / 8, WINDOW_WIDTH / 4, WINDOW_HEIGHT / 8);
+	DrawText(TEXT_LEVEL, "Level: " + to_string(level), levelRect);
 }
 
 void Game::DrawTitle(SDL_Rect& newGameRect, SDL_Rect& quitRect)
 {
 	SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-	SDL_Surface* titleSurf = TTF_RenderText_Solid(font, "TETRIS", { 255, 255, 255 });
-	SDL_Texture* titleText = SDL_CreateTextureFromSurface(renderer, titleSurf);
-	SDL_Rect titleRect{ WINDOW_WIDTH / 4, WINDOW_HEIGHT / 12, WINDOW_WIDTH / 2, WINDOW_HEIGHT / 3 };
-	SDL_RenderCopy(renderer, titleText, NULL, &titleRect);
-	
-	SDL_Surface* newGameSurf = TTF_RenderText_Solid(font, "New Game", { 255, 255, 255 });
-	SDL_Texture* newGameText = SDL_CreateTextureFromSurface(renderer, newGameSurf);
-	newGameRect = { WINDOW_WIDTH / 3, WINDOW_HEIGHT / 3 + WINDOW_HEIGHT / 12, WINDOW_WIDTH / 3, WINDOW_HEIGHT / 6 };
-	SDL_RenderCopy(renderer, newGameText, NULL, &newGameRect);
-
-	SDL_Surface* quitSurf = TTF_RenderText_Solid(font, "Quit", { 255, 255, 255 });
-	SDL_Texture* quitText = SDL_CreateTextureFromSurface(renderer, quitSurf);
-	quitRect = { WINDOW_WIDTH * 5 / 12, WINDOW_HEIGHT * 2 / 3 - WINDOW_HEIGHT / 12, WINDOW_WIDTH / 6, WINDOW_HEIGHT / 6 };
-	SDL_RenderCopy(renderer, quitText, NULL, &quitRect);
-	
-	SDL_DestroyTexture(titleText);
-	SDL_DestroyTexture(newGameText);
-	SDL_DestroyTexture(quitText);
-	SDL_FreeSurface(titleSurf);
-	SDL_FreeSurface(newGameSurf);
-	SDL_FreeSurface(quitSurf);
+	SDL_Rect titleRect = ToScreen(WINDOW_WIDTH / 4, WINDOW_HEIGHT / 12, WINDOW_WIDTH / 2, WINDOW_HEIGHT / 3);
+	DrawText(TEXT_TITLE, "TETRIS", titleRect);
+
+	newGameRect = ToScreen(WINDOW_WIDTH / 3, WINDOW_HEIGHT / 3 + WINDOW_HEIGHT / 12, WINDOW_WIDTH / 3, WINDOW_HEIGHT / 6);
+	DrawText(TEXT_NEW_GAME, "New Game", newGameRect);
+
+	quitRect = ToScreen(WINDOW_WIDTH * 5 / 12, WINDOW_HEIGHT * 2 / 3 - WINDOW_HEIGHT / 12, WINDOW_WIDTH / 6, WINDOW_HEIGHT / 6);
+	DrawText(TEXT_QUIT, "Quit", quitRect);
 }
 
 void Game::DrawGameOver(SDL_Rect& newGameRect, SDL_Rect& quitRect)
 {
 	SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 	// draw score
-	string text = "Your score: " + to_string(scores);
-	SDL_Surface* scoreSurf = TTF_RenderText_Solid(font, text.c_str(), { 255, 255, 255 });
-	SDL_Texture* scoreText = SDL_CreateTextureFromSurface(renderer, scoreSurf);
-	SDL_Rect scroreRect = { WINDOW_WIDTH / 5, 0 + WINDOW_HEIGHT / 12, WINDOW_WIDTH * 3 / 5, WINDOW_HEIGHT / 3 };
-	SDL_RenderCopy(renderer, scoreText, NULL, &scroreRect);
+	SDL_Rect scroreRect = ToScreen(WINDOW_WIDTH / 5, 0 + WINDOW_HEIGHT / 12, WINDOW_WIDTH * 3 / 5, WINDOW_HEIGHT / 3);
+	DrawText(TEXT_FINAL_SCORE, "Your score: " + to_string(scores), scroreRect);
 
 	// try again
-	SDL_Surface* newGameSurf = TTF_RenderText_Solid(font, "Try again", { 255, 255, 255 });
-	SDL_Texture* newGameText = SDL_CreateTextureFromSurface(renderer, newGameSurf);
-	newGameRect = { WINDOW_WIDTH / 3, WINDOW_HEIGHT / 3 + WINDOW_HEIGHT / 12, WINDOW_WIDTH / 3, WINDOW_HEIGHT / 6 };
-	SDL_RenderCopy(renderer, newGameText, NULL, &newGameRect);
+	newGameRect = ToScreen(WINDOW_WIDTH / 3, WINDOW_HEIGHT / 3 + WINDOW_HEIGHT / 12, WINDOW_WIDTH / 3, WINDOW_HEIGHT / 6);
+	DrawText(TEXT_TRY_AGAIN, "Try again", newGameRect);
 
 	// quit
-	SDL_Surface* quitSurf = TTF_RenderText_Solid(font, "Quit", { 255, 255, 255 });
-	SDL_Texture* quitText = SDL_CreateTextureFromSurface(renderer, quitSurf);
-	quitRect = { WINDOW_WIDTH * 5 / 12, WINDOW_HEIGHT * 2 / 3, WINDOW_WIDTH / 6, WINDOW_HEIGHT / 6 };
-	SDL_RenderCopy(renderer, quitText, NULL, &quitRect);
-
-	SDL_DestroyTexture(scoreText);
-	SDL_DestroyTexture(newGameText);
-	SDL_DestroyTexture(quitText);
-	SDL_FreeSurface(scoreSurf);
-	SDL_FreeSurface(newGameSurf);
-	SDL_FreeSurface(quitSurf);
-
+	quitRect = ToScreen(WINDOW_WIDTH * 5 / 12, WINDOW_HEIGHT * 2 / 3, WINDOW_WIDTH / 6, WINDOW_HEIGHT / 6);
+	DrawText(TEXT_QUIT, "Quit", quitRect);
 }
 
 // return lowest y at each col which can place the rect
@@ -534,9 +857,11 @@ void Game::Start(bool& quit, bool& start, bool& run, SDL_Event& e, SDL_Rect& new
 	while (SDL_PollEvent(&e) != 0)
 		if (e.type == SDL_QUIT)
 			quit = true;
+		else if (e.type == SDL_WINDOWEVENT || e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET)
+			HandleWindowEvent(e);
 		else if (e.type == SDL_MOUSEBUTTONDOWN)
 		{
-			SDL_GetMouseState(&x, &y);
+			GetMousePosition(x, y);
 			if (x >= newGameRect.x && x <= newGameRect.x + newGameRect.w && y >= newGameRect.y && y <= newGameRect.y + newGameRect.h)
 			{
 				start = false;
@@ -546,7 +871,7 @@ void Game::Start(bool& quit, bool& start, bool& run, SDL_Event& e, SDL_Rect& new
 				quit = true;
 		}
 
-	SDL_GetMouseState(&x, &y);
+	GetMousePosition(x, y);
 	if (x >= newGameRect.x && x <= newGameRect.x + newGameRect.w && y >= newGameRect.y && y <= newGameRect.y + newGameRect.h)
 		SDL_RenderDrawRect(renderer, &newGameRect);
 	else if (x >= quitRect.x && x <= quitRect.x + quitRect.w && y >= quitRect.y && y <= quitRect.y + quitRect.h)
@@ -554,8 +879,8 @@ void Game::Start(bool& quit, bool& start, bool& run, SDL_Event& e, SDL_Rect& new
 
 }
 
-// main loop
-void Game::Run(bool& quit, bool& run, bool& end, SDL_Event& e, bool& getNewPiece, int& xPos, int& yPos, int& frameCount, int& lockDelay, bool& lockDelayExpired)
+// main loop, input is handled every frame while the simulation steps at a fixed FPS
+void Game::Run(bool& quit, bool& run, bool& end, SDL_Event& e, bool& getNewPiece, int& xPos, int& yPos, int& frameCount, int& lockDelay, bool& lockDelayExpired, double& accumulator)
 {
 
 	// game loop
@@ -566,22 +891,34 @@ void Game::Run(bool& quit, bool& run, bool& end, SDL_Event& e, bool& getNewPiece
 		getNewPiece = false;
 		xPos = 3;
 		yPos = 0;
+		prevXPos = (float)xPos;
+		prevYPos = (float)yPos;
 		frameCount = 0;
 		lockDelay = 0;
 		lockDelayExpired = false;
+		botRequested = false;
 	}
 
+	// bot input goes through the same event queue as the keyboard
+	UpdateAutoplay(xPos, yPos);
+
 	// user input
+	overlay.Begin(PerfOverlay::PHASE_EVENTS);
 	while (SDL_PollEvent(&e) != 0)
 	{
 		if (e.type == SDL_QUIT)
 			quit = true;
+		else if (e.type == SDL_WINDOWEVENT || e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET)
+			HandleWindowEvent(e);
 		else if (e.type == SDL_KEYDOWN)
 		{
 			switch (e.key.keysym.sym)
 			{
 			case SDLK_UP:
+				// the shape changes at once, so don't slide the rotated piece
 				Rotate(xPos, yPos);
+				prevXPos = (float)xPos;
+				prevYPos = (float)yPos;
 				break;
 			case SDLK_DOWN:
 				if (IsValidPosition(currPiece.shape, xPos, yPos + 1))
@@ -597,12 +934,75 @@ void Game::Run(bool& quit, bool& run, bool& end, SDL_Event& e, bool& getNewPiece
 				break;
 			case SDLK_SPACE:
 				HardDrop(xPos, yPos);
+				EmitDropDust(xPos, yPos);
+				prevYPos = (float)yPos;
 				frameCount = framePerGridCell;
 				lockDelayExpired = true;
 				break;
+			case SDLK_F3:
+				overlay.Toggle();
+				break;
+			case SDLK_a:
+				SetAutoplay(!autoplay);
+				break;
 			}
 		}
 	}
+	overlay.End(PerfOverlay::PHASE_EVENTS);
+
+	// fixed step simulation, stop at a lock so the next piece is spawned first
+	const double tick = 1.0 / FPS;
+	overlay.Begin(PerfOverlay::PHASE_SIMULATION);
+	while (accumulator >= tick && run && !getNewPiece)
+	{
+		Step(run, end, getNewPiece, xPos, yPos, frameCount, lockDelay, lockDelayExpired);
+		accumulator -= tick;
+	}
+	overlay.End(PerfOverlay::PHASE_SIMULATION);
+	if (getNewPiece || !run)
+		accumulator = min(accumulator, tick);
+	float alpha = (float)(accumulator / tick);
+
+	// the terminal shows the board at the last tick and nothing else
+	if (terminalView)
+	{
+		DrawTerminal(xPos, yPos);
+		return;
+	}
+
+	// draw scores
+	overlay.Begin(PerfOverlay::PHASE_TEXT);
+	DrawScore();
+	// draw level
+	DrawLevel();
+	overlay.End(PerfOverlay::PHASE_TEXT);
+	// draw current piece between the last two ticks
+	if (!getNewPiece)
+		DrawPiece(prevXPos + (xPos - prevXPos) * alpha, prevYPos + (yPos - prevYPos) * alpha);
+	// draw next piece
+	DrawNextPiece();
+	// draw the lowest possbile pos
+	if (!getNewPiece)
+		DrawLowestPos(xPos, yPos);
+	// draw the entire map
+	overlay.Begin(PerfOverlay::PHASE_BOARD);
+	DrawGameboard(alpha);
+	overlay.End(PerfOverlay::PHASE_BOARD);
+	// draw line clear and drop effects
+	particles.Update();
+	overlay.CountDrawCall(particles.Draw(renderer, (float)cellSize, (float)offsetX, (float)(offsetY - BUFFER_HEIGHT * cellSize)));
+}
+
+// advance the simulation by one frame
+void Game::Step(bool& run, bool& end, bool& getNewPiece, int& xPos, int& yPos, int& frameCount, int& lockDelay, bool& lockDelayExpired)
+{
+	prevXPos = (float)xPos;
+	prevYPos = (float)yPos;
+	for (int y = 0; y < GAMEBOARD_HEIGHT; y++)
+	{
+		prevRowOffset[y] = rowOffset[y];
+		rowOffset[y] = max(0.0f, rowOffset[y] - 1.0f / COLLAPSE_FRAME);
+	}
 
 	// piece free fall
 	if (IsValidPosition(currPiece.shape, xPos, yPos + 1) && frameCount == framePerGridCell)
@@ -632,19 +1032,6 @@ void Game::Run(bool& quit, bool& run, bool& end, SDL_Event& e, bool& getNewPiece
 		}
 	}
 
-	// draw scores
-	DrawScore();
-	// draw level
-	DrawLevel();
-	// draw current piece
-	DrawPiece(xPos, yPos);
-	// draw next piece
-	DrawNextPiece();
-	// draw the lowest possbile pos
-	DrawLowestPos(xPos, yPos);
-	// draw the entire map
-	DrawGameboard();
-
 	frameCount += 1;
 }
 
@@ -657,9 +1044,11 @@ void Game::End(bool& quit, bool& run, bool& end, SDL_Event& e, SDL_Rect& newGame
 	{
 		if (e.type == SDL_QUIT)
 			quit = true;
+		else if (e.type == SDL_WINDOWEVENT || e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET)
+			HandleWindowEvent(e);
 		else if (e.type == SDL_MOUSEBUTTONDOWN)
 		{
-			SDL_GetMouseState(&x, &y);
+			GetMousePosition(x, y);
 			if (x >= newGameRect.x && x <= newGameRect.x + newGameRect.w && y >= newGameRect.y && y <= newGameRect.y + newGameRect.h)
 			{
 				InitGameData();
@@ -671,7 +1060,7 @@ void Game::End(bool& quit, bool& run, bool& end, SDL_Event& e, SDL_Rect& newGame
 		}
 	}
 
-	SDL_GetMouseState(&x, &y);
+	GetMousePosition(x, y);
 	if (x >= newGameRect.x && x <= newGameRect.x + newGameRect.w && y >= newGameRect.y && y <= newGameRect.y + newGameRect.h)
 		SDL_RenderDrawRect(renderer, &newGameRect);
 	else if (x >= quitRect.x && x <= quitRect.x + quitRect.w && y >= quitRect.y && y <= quitRect.y + quitRect.h)
@@ -681,6 +1070,12 @@ void Game::End(bool& quit, bool& run, bool& end, SDL_Event& e, SDL_Rect& newGame
 
 void Game::StartGame()
 {
+	if (terminalView)
+	{
+		StartTerminal();
+		return;
+	}
+
 	bool quit = false;
 	bool start = true;
 	bool run = false;
@@ -699,21 +1094,96 @@ void Game::StartGame()
 	int frameCount = 0;
 	int lockDelay = 0;
 	bool lockDelayExpired = false;
+	double accumulator = 0;
+	Uint64 lastCounter = SDL_GetPerformanceCounter();
 
 	Mix_PlayMusic(bgm, -1);
 
 	while (!quit)
 	{
+		// real time since the last frame, clamped so a stall doesn't fast-forward the game
+		Uint64 counter = SDL_GetPerformanceCounter();
+		accumulator += min((double)(counter - lastCounter) / SDL_GetPerformanceFrequency(), 0.25);
+		lastCounter = counter;
+		overlay.BeginFrame();
+
 		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
 		SDL_RenderClear(renderer);
 
 		if (start && !run && !end)
 			Start(quit, start, run, e, newGameRect, quitRect);
 		else if (!start && run && !end)
-			Run(quit, run, end, e, getNewPiece, xPos, yPos, frameCount, lockDelay, lockDelayExpired);
+			Run(quit, run, end, e, getNewPiece, xPos, yPos, frameCount, lockDelay, lockDelayExpired, accumulator);
 		else if (!start && !run && end)
 			End(quit, run, end, e, newGameRect, quitRect);
 
+		// the simulation clock only runs during a game
+		if (!run)
+			accumulator = 0;
+
+		// frame timings, toggled with F3
+		SDL_Rect overlayRect = ToScreen(WINDOW_WIDTH * 5 / 8, WINDOW_HEIGHT * 11 / 16, 0, 0);
+		overlay.Draw(renderer, font, overlayRect.x, overlayRect.y, max(1, (int)(HUD_LINE_HEIGHT * scale)));
+
+		overlay.Begin(PerfOverlay::PHASE_PRESENT);
 		SDL_RenderPresent(renderer);
+		overlay.End(PerfOverlay::PHASE_PRESENT);
 	}
-}
\ No newline at end of file
+}
+
+// the game without a window: it starts at once, keys come from the console or autoplay and the board is drawn into the terminal
+// a game over starts a new game while the bot plays and ends the session otherwise, q or ctrl-c quits
+void Game::StartTerminal()
+{
+	static const SDL_Keycode KEYCODES[] = { SDLK_UNKNOWN, SDLK_LEFT, SDLK_RIGHT, SDLK_UP, SDLK_DOWN, SDLK_SPACE, SDLK_a };
+	bool quit = false;
+	bool run = true;
+	bool end = false;
+	SDL_Event e;
+	bool getNewPiece = true;
+	int xPos = 3;
+	int yPos = 0;
+	int frameCount = 0;
+	int lockDelay = 0;
+	bool lockDelayExpired = false;
+	double accumulator = 0;
+	Uint64 lastCounter = SDL_GetPerformanceCounter();
+
+	// without a console to read keys from only the bot can play
+	if (!terminal.EnableInput() && !autoplay)
+		SetAutoplay(true);
+
+	while (!quit)
+	{
+		Uint64 counter = SDL_GetPerformanceCounter();
+		accumulator += min((double)(counter - lastCounter) / SDL_GetPerformanceFrequency(), 0.25);
+		lastCounter = counter;
+
+		// console keys go through the event queue like the window's
+		for (int key = terminal.ReadKey(); key != TerminalRenderer::KEY_NONE; key = terminal.ReadKey())
+			if (key == TerminalRenderer::KEY_QUIT)
+				quit = true;
+			else
+			{
+				SDL_Event keyEvent{};
+				keyEvent.type = SDL_KEYDOWN;
+				keyEvent.key.keysym.sym = KEYCODES[key];
+				SDL_PushEvent(&keyEvent);
+			}
+
+		Run(quit, run, end, e, getNewPiece, xPos, yPos, frameCount, lockDelay, lockDelayExpired, accumulator);
+		if (end)
+		{
+			if (autoplay)
+			{
+				InitGameData();
+				run = true;
+				end = false;
+			}
+			else
+				quit = true;
+		}
+		SDL_Delay(1000 / FPS);
+	}
+	terminal.DisableInput();
+}
@@ -6,9 +6,17 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include "TerminalRenderer.h"
+#include "ParticleSystem.h"
+#include "PerfOverlay.h"
 
 using namespace std;
 
+struct BitBoard;
+struct Placement;
+class Bot;
+class OpeningBook;
+
 struct Color
 {
 	int r, g, b, a;
@@ -20,8 +28,12 @@ struct Piece
 {
 	string shape = "";
 	Color color = Color();
+	// index in PIECE and number of clockwise turns from the spawn shape
+	int type = -1;
+	int rotation = 0;
 	Piece();
 	Piece(string s, Color c);
+	Piece(string s, Color c, int t);
 	bool IsEmpty();
 };
 
@@ -39,15 +51,40 @@ public:
 	static const int MAX_DROP_RATE = 48;
 	static const int DECREASE_RATE = 5;
 	static const int LOCKDELAYFRAME = 15;
+	static const int COLLAPSE_FRAME = 4;
+	static const int FONT_SIZE = 60;
+	static const int HUD_LINE_HEIGHT = 14;
+	static const int TEXT_SCORE = 0;
+	static const int TEXT_LEVEL = 1;
+	static const int TEXT_TITLE = 2;
+	static const int TEXT_NEW_GAME = 3;
+	static const int TEXT_QUIT = 4;
+	static const int TEXT_FINAL_SCORE = 5;
+	static const int TEXT_TRY_AGAIN = 6;
+	static const int TEXT_NUM = 7;
+	static const int WALL_BLOCK = 7;
 	static const string PIECE[7];
 	static const Color COLOR[7];
 private:
 	SDL_Window* window = nullptr;
 	SDL_Surface* screen = nullptr;
 	SDL_Renderer* renderer = nullptr;
-	TTF_Font* font;
-	Mix_Music* bgm;
+	TTF_Font* font = nullptr;
+	Mix_Music* bgm = nullptr;
+	// layout in output pixels, only recomputed when the window size changes
+	float scale = 1;
+	int cellSize = CELL_SIZE;
+	int offsetX = 0;
+	int offsetY = 0;
+	int fontSize = FONT_SIZE;
+	// one pre-rendered cell per piece color plus the wall, rebuilt with the layout
+	SDL_Texture* blockAtlas = nullptr;
+	// rendered text, recreated only when the string or the layout changes
+	SDL_Texture* textTexture[TEXT_NUM] = {};
+	string textString[TEXT_NUM];
 	char gameboard[GAMEBOARD_WIDTH * GAMEBOARD_HEIGHT];
+	// same hash as BitBoard::hash, updated with the rows touched by Update and ClearLine
+	unsigned long long boardHash = 0;
 	Color colorBoard[GAMEBOARD_WIDTH * GAMEBOARD_HEIGHT];
 	int level;
 	int framePerGridCell;
@@ -56,23 +93,71 @@ private:
 	Piece currPiece;
 	Piece nextPiece;
 	vector<int> index;
+	// previous simulation tick, used to interpolate drawing between ticks
+	float prevXPos;
+	float prevYPos;
+	float rowOffset[GAMEBOARD_HEIGHT];
+	float prevRowOffset[GAMEBOARD_HEIGHT];
+	ParticleSystem particles;
+	PerfOverlay overlay;
+	TerminalRenderer terminal;
+	// played in the terminal alone, without a window, audio or font
+	bool terminalView = false;
+	// autoplay, the bot's moves are fed in as key events
+	Bot* bot = nullptr;
+	string networkPath;
+	// first bag moves, the pieces drawn so far in the first bag of the session and the next one after it
+	OpeningBook* book = nullptr;
+	vector<int> opening;
+	bool autoplay = false;
+	// index in Bot::LEVEL
+	int botLevel;
+	// autoplay keys wait for this tick at levels with limited actions per second
+	Uint32 botNextAction = 0;
+	bool botRequested = false;
+	bool botPlanned = false;
+	Uint32 botDeadline = 0;
+	bool botHasMove = false;
+	Placement* botMove = nullptr;
+	vector<SDL_Keycode> botKeys;
 public:
-	Game();
+	Game(bool terminalOnly = false);
 	~Game();
 	bool InitSuccess();
 	void InitGameData();
 	void InitGameBoard();
 	void GetNextOrder();
-	void DrawPiece(int xPos, int yPos);
-	void DrawPieceRect(Color& color, int xPos, int yPos);
+	void DrawPiece(float xPos, float yPos);
+	void DrawPieceRect(Color& color, float xPos, float yPos);
+	void DrawBlock(Color& color, float xPixel, float yPixel);
+	void DrawText(int slot, const string& text, SDL_Rect& rect);
+	void UpdateLayout();
+	void BuildBlockAtlas();
+	void FreeTextures();
+	int FindBlock(Color& color);
+	SDL_Rect ToScreen(int x, int y, int w, int h);
+	void GetMousePosition(int& x, int& y);
+	void HandleWindowEvent(SDL_Event& e);
 	void Update(int xPos, int yPos);
-	void DrawGameboard();
+	void DrawGameboard(float alpha);
 	void PrintMap();
+	void DrawTerminal(int xPos, int yPos);
+	void SetAutoplay(bool enable);
+	void SetNetwork(const string& path);
+	bool SetBook(const string& path);
+	void SetBotLevel(int level);
+	void UpdateAutoplay(int xPos, int yPos);
+	void PlanKeys(Placement& move, int xPos, int yPos);
+	BitBoard GetBitBoard();
+	int GetBagMask();
+	int GetThinkMillisecond(int yPos);
+	unsigned long long HashRow(int y);
 	void GetNewPiece();
 	void Rotate(int& xPos, int yPos);
 	void CheckLine(int yLine);
 	void ClearLine(int yLine);
 	void HardDrop(int xPos, int& yPos);
+	void EmitDropDust(int xPos, int yPos);
 	void AddScore(int rowClear);
 	void DrawLowestPos(int xPos, int yPos);
 	void DrawNextPiece();
@@ -86,7 +171,9 @@ public:
 	bool IsGameOver();
 	void PlayBGM();
 	void Start(bool& quit, bool& start, bool& run, SDL_Event &e, SDL_Rect& newGameRect, SDL_Rect& quitRect);
-	void Run(bool& quit, bool& run, bool& end, SDL_Event& e, bool& getNewPiece, int& xPos, int& yPos, int& frameCount, int& lockDelay, bool& lockDelayExpired);
+	void Run(bool& quit, bool& run, bool& end, SDL_Event& e, bool& getNewPiece, int& xPos, int& yPos, int& frameCount, int& lockDelay, bool& lockDelayExpired, double& accumulator);
+	void Step(bool& run, bool& end, bool& getNewPiece, int& xPos, int& yPos, int& frameCount, int& lockDelay, bool& lockDelayExpired);
 	void End(bool& quit, bool& run, bool& end, SDL_Event& e, SDL_Rect& newGameRect, SDL_Rect& quitRect);
 	void StartGame();
+	void StartTerminal();
 };
\ No newline at end of file
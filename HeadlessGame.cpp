@@ -0,0 +1,116 @@
+#include "HeadlessGame.h"
+#include "MoveGen.h"
+#include <algorithm>
+
+HeadlessGame::HeadlessGame(unsigned int seed)
+{
+	Reset(seed);
+}
+
+void HeadlessGame::Reset(unsigned int seed)
+{
+	board.Clear();
+	random.seed(seed);
+	indexSize = 0;
+	scores = 0;
+	level = 0;
+	clearLinesNum = 0;
+	pieces = 0;
+	gameOver = false;
+	currType = PopPiece();
+	nextType = PopPiece();
+}
+
+// lock the current piece where the move says, score it like Game::AddScore and bring in the next piece
+int HeadlessGame::Step(const Placement& move)
+{
+	if (gameOver)
+		return 0;
+	int linesNum = board.Place(currType, move);
+	clearLinesNum += linesNum;
+	scores += LineScore(linesNum, board.IsPerfectClear(), level);
+	if (clearLinesNum >= 10 * (level + 1))
+		level += 1;
+	pieces += 1;
+
+	currType = nextType;
+	nextType = PopPiece();
+	gameOver = board.IsGameOver() || !board.Fits(currType, 0, MoveGen::SPAWN_X, MoveGen::SPAWN_Y);
+	return linesNum;
+}
+
+// garbage rows from the opponent in versus play, pushing the stack into the buffer rows loses like a bad placement
+void HeadlessGame::AddGarbage(int linesNum, int hole)
+{
+	if (gameOver || linesNum <= 0)
+		return;
+	bool fits = board.AddGarbage(linesNum, hole);
+	gameOver = !fits || board.IsGameOver() || !board.Fits(currType, 0, MoveGen::SPAWN_X, MoveGen::SPAWN_Y);
+}
+
+// pieces left in the bag after nextType, see Expectimax
+int HeadlessGame::GetBagMask() const
+{
+	int mask = 0;
+	for (int i = 0; i < indexSize; i++)
+		mask |= 1 << index[i];
+	return mask ? mask : 0x7F;
+}
+
+// reseed and reshuffle the part of the bag that hasn't been shown, so a copy plays one of the possible futures
+void HeadlessGame::Determinize(unsigned int seed)
+{
+	random.seed(seed);
+	shuffle(index, index + indexSize, random);
+}
+
+int HeadlessGame::LineScore(int linesNum, bool perfectClear, int level)
+{
+	if (perfectClear)
+		return 800 * (level + 1);
+	switch (linesNum)
+	{
+	case 1:
+		return 40 * (level + 1);
+	case 2:
+		return 100 * (level + 1);
+	case 3:
+		return 300 * (level + 1);
+	case 4:
+		return 1200 * (level + 1);
+	}
+	return 0;
+}
+
+int HeadlessGame::FramePerGridCell(int level)
+{
+	if (level < 9)
+		return Game::MAX_DROP_RATE - level * Game::DECREASE_RATE;
+	else if (level == 9)
+		return 6;
+	else if (level >= 10 && level <= 12)
+		return 5;
+	else if (level >= 13 && level <= 15)
+		return 4;
+	else if (level >= 16 && level <= 18)
+		return 3;
+	else if (level >= 19 && level <= 28)
+		return 2;
+	return 1;
+}
+
+void HeadlessGame::GetNextOrder()
+{
+	for (int n = 0; n < 7; n++)
+		index[n] = n;
+	indexSize = 7;
+	shuffle(index, index + indexSize, random);
+}
+
+int HeadlessGame::PopPiece()
+{
+	if (indexSize == 0)
+		GetNextOrder();
+	indexSize -= 1;
+	return index[indexSize];
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <random>
+#include "BitBoard.h"
+
+// the rules of Game without a window: the 7-bag, placing whole pieces, scoring and levels
+// used to simulate games for rollouts, tuning and benchmarks, a seed always gives the same pieces
+class HeadlessGame
+{
+public:
+	BitBoard board;
+	int currType;
+	int nextType;
+	int scores;
+	int level;
+	int clearLinesNum;
+	int pieces;
+	bool gameOver;
+private:
+	mt19937 random;
+	// pieces left in the bag, taken from the back like Game::index, fixed size so copies don't allocate
+	int index[7];
+	int indexSize;
+public:
+	HeadlessGame(unsigned int seed = 0);
+	void Reset(unsigned int seed);
+	int Step(const Placement& move);
+	void AddGarbage(int linesNum, int hole);
+	int GetBagMask() const;
+	void Determinize(unsigned int seed);
+	static int LineScore(int linesNum, bool perfectClear, int level);
+	static int FramePerGridCell(int level);
+private:
+	void GetNextOrder();
+	int PopPiece();
+};
@@ -0,0 +1,259 @@
+#include "Mcts.h"
+#include "MoveGen.h"
+#include <algorithm>
+#include <cmath>
+
+// deepest path through the tree, far more than a search reaches
+static const int MAX_PATH = 64;
+
+Mcts::Mcts(ThreadPool& threadPool, int capacity) : pool(threadPool)
+{
+	nodeCapacity = capacity;
+	edgeCapacity = capacity * 4;
+	nodes.reset(new Node[nodeCapacity]);
+	edges.reset(new Edge[edgeCapacity]);
+	nodeCount = 0;
+	edgeCount = 0;
+	rollouts = 0;
+	weights = nullptr;
+	rootValue = 0;
+}
+
+// run iterations on every thread until the time, the rollouts or the arena run out, then pick the most visited move
+// with one thread and no time limit the same seed always gives the same move
+bool Mcts::Search(const HeadlessGame& game, double seconds, long long maxRollouts, unsigned int seed, const EvalWeights& searchWeights, const atomic<bool>& cancel, Placement& best)
+{
+	nodeCount = 0;
+	edgeCount = 0;
+	rollouts = 0;
+	weights = &searchWeights;
+	if (game.gameOver)
+		return false;
+	rootValue = Value(game, 0);
+	int root = NewNode();
+	if (!Expand(root, game) || nodes[root].edgeNum == 0)
+		return false;
+
+	chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+	atomic<unsigned int> iteration(0);
+	pool.ParallelFor(pool.Size(), [&](int) {
+		while (!cancel && rollouts < maxRollouts && nodeCount < nodeCapacity && chrono::steady_clock::now() < deadline)
+			Iterate(game, seed * 0x9E3779B9u + iteration++);
+	});
+
+	const Node& rootNode = nodes[root];
+	int bestEdge = rootNode.firstEdge;
+	for (int e = rootNode.firstEdge; e < rootNode.firstEdge + rootNode.edgeNum; e++)
+		if (edges[e].visits > edges[bestEdge].visits)
+			bestEdge = e;
+	best = edges[bestEdge].move;
+	return true;
+}
+
+long long Mcts::GetRollouts()
+{
+	return rollouts;
+}
+
+int Mcts::GetNodes()
+{
+	return min((int)nodeCount, nodeCapacity);
+}
+
+// one selection, expansion, rollout and backup on a sampled future of root
+void Mcts::Iterate(const HeadlessGame& root, unsigned int seed)
+{
+	HeadlessGame game = root;
+	game.Determinize(seed);
+	int path[MAX_PATH];
+	int depth = 0;
+	int node = 0;
+	float lineValue = 0;
+	bool lost = false;
+	// the node the path stops on was already counted when it stops after a move, on a top out or a full arena
+	bool counted = false;
+	while (depth < MAX_PATH)
+	{
+		Node& current = nodes[node];
+		// a node is expanded on its second visit, until then it only gets rollouts
+		if (current.firstEdge.load(memory_order_acquire) < 0 && (current.visits == 0 || !Expand(node, game)))
+			break;
+		if (current.edgeNum == 0)
+		{
+			lost = true;
+			break;
+		}
+
+		// the visit is counted now and the reward added at the end, meanwhile it acts as a virtual loss
+		int edge = Select(node);
+		path[depth++] = edge;
+		current.visits += 1;
+		counted = true;
+		lineValue += game.Step(edges[edge].move) * weights->weight[BoardFeatures::LINES];
+		if (game.gameOver)
+		{
+			lost = true;
+			break;
+		}
+
+		int child = edges[edge].next[game.currType];
+		if (child < 0)
+		{
+			int created = NewNode();
+			if (created < 0)
+				break;
+			int expected = -1;
+			// another thread may have added the same child first, then its node is used and ours is wasted
+			child = edges[edge].next[game.currType].compare_exchange_strong(expected, created) ? created : expected;
+		}
+		node = child;
+		counted = false;
+	}
+
+	float reward = lost ? 0 : Rollout(game, lineValue);
+	if (!counted)
+		nodes[node].visits += 1;
+	for (int i = 0; i < depth; i++)
+		Add(edges[path[i]].value, reward);
+	rollouts += 1;
+}
+
+int Mcts::NewNode()
+{
+	int node = nodeCount++;
+	if (node >= nodeCapacity)
+		return -1;
+	nodes[node].visits = 0;
+	nodes[node].edgeNum = 0;
+	nodes[node].firstEdge.store(UNEXPANDED, memory_order_release);
+	return node;
+}
+
+// add the best placements of the current piece as edges, false if another thread is expanding it or the arena is full
+bool Mcts::Expand(int node, const HeadlessGame& game)
+{
+	int expected = UNEXPANDED;
+	if (!nodes[node].firstEdge.compare_exchange_strong(expected, EXPANDING))
+		return nodes[node].firstEdge >= 0;
+
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	BitBoard boards[MoveGen::MAX_PLACEMENTS];
+	const BitBoard* boardPtr[MoveGen::MAX_PLACEMENTS];
+	int noLines[MoveGen::MAX_PLACEMENTS] = {};
+	int lines[MoveGen::MAX_PLACEMENTS];
+	float scores[MoveGen::MAX_PLACEMENTS];
+	int order[MoveGen::MAX_PLACEMENTS];
+	int placementNum = MoveGen::Generate(game.board, game.currType, placements);
+	int count = 0;
+	for (int i = 0; i < placementNum; i++)
+	{
+		if (placements[i].tuck && !allowTucks)
+			continue;
+		placements[count] = placements[i];
+		boards[count] = game.board;
+		lines[count] = boards[count].Place(game.currType, placements[i]);
+		boardPtr[count] = &boards[count];
+		order[count] = count;
+		count += 1;
+	}
+	Evaluator::ScoreBatch(boardPtr, noLines, count, *weights, scores);
+	for (int i = 0; i < count; i++)
+		scores[i] += lines[i] * weights->weight[BoardFeatures::LINES];
+	int edgeNum = min(count, MAX_EDGES);
+	partial_sort(order, order + edgeNum, order + count, [&](int a, int b) { return scores[a] > scores[b]; });
+
+	int first = edgeCount.fetch_add(edgeNum);
+	if (first + edgeNum > edgeCapacity)
+	{
+		nodes[node].firstEdge = UNEXPANDED;
+		return false;
+	}
+	for (int i = 0; i < edgeNum; i++)
+	{
+		Edge& edge = edges[first + i];
+		edge.move = placements[order[i]];
+		edge.prior = scores[order[i]];
+		edge.visits = 0;
+		edge.value = 0;
+		for (int type = 0; type < 7; type++)
+			edge.next[type] = -1;
+	}
+	nodes[node].edgeNum = edgeNum;
+	nodes[node].firstEdge.store(first, memory_order_release);
+	return true;
+}
+
+// UCT, unvisited edges first in the order of their static score
+int Mcts::Select(int node)
+{
+	const Node& current = nodes[node];
+	float logVisits = log((float)current.visits + 1);
+	int best = current.firstEdge;
+	float bestScore = -1e30f;
+	for (int e = current.firstEdge; e < current.firstEdge + current.edgeNum; e++)
+	{
+		int visits = edges[e].visits;
+		if (visits == 0)
+		{
+			best = e;
+			break;
+		}
+		float score = edges[e].value / visits + exploration * sqrt(logVisits / visits);
+		if (score > bestScore)
+		{
+			bestScore = score;
+			best = e;
+		}
+	}
+	edges[best].visits += 1;
+	return best;
+}
+
+// play a few pieces greedily by static score, tucks included, and squash the result against the root into 0 .. 1
+float Mcts::Rollout(HeadlessGame& game, float lineValue)
+{
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	BitBoard boards[MoveGen::MAX_PLACEMENTS];
+	const BitBoard* boardPtr[MoveGen::MAX_PLACEMENTS];
+	int noLines[MoveGen::MAX_PLACEMENTS] = {};
+	float scores[MoveGen::MAX_PLACEMENTS];
+	for (int piece = 0; piece < ROLLOUT_PIECES; piece++)
+	{
+		int count = MoveGen::Generate(game.board, game.currType, placements);
+		int lines[MoveGen::MAX_PLACEMENTS];
+		for (int i = 0; i < count; i++)
+		{
+			boards[i] = game.board;
+			lines[i] = boards[i].Place(game.currType, placements[i]);
+			boardPtr[i] = &boards[i];
+		}
+		if (count == 0)
+			return 0;
+		Evaluator::ScoreBatch(boardPtr, noLines, count, *weights, scores);
+		int best = 0;
+		for (int i = 0; i < count; i++)
+		{
+			scores[i] += lines[i] * weights->weight[BoardFeatures::LINES];
+			if (scores[i] > scores[best])
+				best = i;
+		}
+		lineValue += game.Step(placements[best]) * weights->weight[BoardFeatures::LINES];
+		if (game.gameOver)
+			return 0;
+	}
+	return 1 / (1 + exp(-(Value(game, lineValue) - rootValue) / rewardScale));
+}
+
+float Mcts::Value(const HeadlessGame& game, float lineValue)
+{
+	return lineValue + Evaluator::Score(game.board, 0, *weights);
+}
+
+// atomic<float> has no fetch_add before C++20
+void Mcts::Add(atomic<float>& target, float amount)
+{
+	float old = target.load(memory_order_relaxed);
+	while (!target.compare_exchange_weak(old, old + amount, memory_order_relaxed))
+	{
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include "Evaluator.h"
+#include "HeadlessGame.h"
+#include "ThreadPool.h"
+
+// monte carlo tree search over placements, every thread of the pool runs iterations on the same tree
+// pieces past the preview are sampled from the bag each iteration, so a node has one child per piece type
+class Mcts
+{
+public:
+	static const int DEFAULT_NODES = 1 << 16;
+	// placements kept per node, the best by static score
+	static const int MAX_EDGES = 12;
+	static const int ROLLOUT_PIECES = 6;
+	float exploration = 0.3f;
+	// evaluation difference that moves the reward from 0.5 to about 0.73
+	float rewardScale = 10.0f;
+	// tree moves include tucks, for callers that can play them; rollouts always do
+	bool allowTucks = false;
+private:
+	// a placement of the node's piece, visits and value include the virtual losses of running iterations
+	struct Edge
+	{
+		Placement move;
+		float prior;
+		atomic<int> visits;
+		atomic<float> value;
+		// node reached by this move for each type of the following piece
+		atomic<int> next[7];
+	};
+	struct Node
+	{
+		atomic<int> visits;
+		// UNEXPANDED, EXPANDING or the first of edgeNum edges
+		atomic<int> firstEdge;
+		int edgeNum;
+	};
+	static const int UNEXPANDED = -1;
+	static const int EXPANDING = -2;
+	ThreadPool& pool;
+	// per-search arena, nodes and edges are taken from the front and the whole search is dropped at once
+	unique_ptr<Node[]> nodes;
+	unique_ptr<Edge[]> edges;
+	int nodeCapacity;
+	int edgeCapacity;
+	atomic<int> nodeCount;
+	atomic<int> edgeCount;
+	atomic<long long> rollouts;
+	const EvalWeights* weights;
+	float rootValue;
+public:
+	Mcts(ThreadPool& threadPool, int capacity = DEFAULT_NODES);
+	bool Search(const HeadlessGame& game, double seconds, long long maxRollouts, unsigned int seed, const EvalWeights& searchWeights, const atomic<bool>& cancel, Placement& best);
+	long long GetRollouts();
+	int GetNodes();
+private:
+	void Iterate(const HeadlessGame& root, unsigned int seed);
+	int NewNode();
+	bool Expand(int node, const HeadlessGame& game);
+	int Select(int node);
+	float Rollout(HeadlessGame& game, float value);
+	float Value(const HeadlessGame& game, float lines);
+	static void Add(atomic<float>& target, float amount);
+};
@@ -0,0 +1,282 @@
+#include "MoveGen.h"
+
+// bits x + PAD for every x a piece may be at
+static const RowMask X_RANGE = (1u << (BitBoard::MAX_X + BitBoard::PAD + 1)) - 1;
+
+struct MoveTables
+{
+	// fit mask on an empty row
+	RowMask openFit[7][4];
+	// x where rotating away from rot needs no wall adjustment
+	RowMask noKick[7][4];
+	MoveTables();
+};
+
+MoveTables::MoveTables()
+{
+	BitBoard empty;
+	for (int type = 0; type < 7; type++)
+		for (int rot = 0; rot < 4; rot++)
+		{
+			openFit[type][rot] = MoveGen::FitMask(empty, type, rot, 0);
+			noKick[type][rot] = 0;
+			for (int x = BitBoard::MIN_X; x <= BitBoard::MAX_X; x++)
+				if (BitBoard::RotateX(type, rot, x) == x)
+					noKick[type][rot] |= 1u << (x + BitBoard::PAD);
+		}
+}
+
+static const MoveTables& Tables()
+{
+	static MoveTables tables;
+	return tables;
+}
+
+// placements from the spawn position used by Game::Run
+int MoveGen::Generate(const BitBoard& board, int type, Placement* placements)
+{
+	return Generate(board, type, SPAWN_X, SPAWN_Y, 0, placements);
+}
+
+// rotate at the start position, shift sideways and drop, then slide once along each landing row for tucks
+// all x of a row are moved together as one bit mask, rotations with the same cells are only generated once
+int MoveGen::Generate(const BitBoard& board, int type, int xPos, int yPos, int rot, Placement* placements)
+{
+	int count = 0;
+	bool done[4] = { false, false, false, false };
+	RowMask fit[BitBoard::HEIGHT + 1];
+	RowMask landed[BitBoard::HEIGHT];
+	RowMask tucked[BitBoard::HEIGHT];
+
+	for (int turn = 0; turn < 4; turn++)
+	{
+		if (!board.Fits(type, rot, xPos, yPos))
+			break;
+
+		int canonical = BitBoard::CanonicalRotation(type, rot);
+		if (!done[canonical])
+		{
+			done[canonical] = true;
+			FitMasks(board, type, rot, fit);
+
+			// shift along the start row, then everything falls until the row below is blocked
+			RowMask falling = Spread(1u << (xPos + BitBoard::PAD), fit[yPos]);
+			int firstY = BitBoard::HEIGHT;
+			int lastY = yPos;
+			for (int y = yPos; falling; y++)
+			{
+				landed[y] = falling & ~fit[y + 1];
+				falling &= fit[y + 1];
+				if (landed[y] && firstY == BitBoard::HEIGHT)
+					firstY = y;
+				lastY = y;
+			}
+
+			// slide along each landing row and fall again, positions already landed on are not tucks
+			for (int y = firstY; y <= lastY || falling; y++)
+			{
+				if (y <= lastY)
+					falling |= Spread(landed[y], fit[y]) & ~landed[y];
+				else
+					landed[y] = 0;
+				tucked[y] = falling & ~fit[y + 1] & ~landed[y];
+				falling &= fit[y + 1];
+				lastY = max(lastY, y);
+			}
+
+			for (int y = firstY; y <= lastY; y++)
+			{
+				for (RowMask bits = landed[y]; bits && count < MAX_PLACEMENTS; bits &= bits - 1)
+					placements[count++] = Placement(LowestBit(bits) - BitBoard::PAD, y, rot, false);
+				for (RowMask bits = tucked[y]; bits && count < MAX_PLACEMENTS; bits &= bits - 1)
+					placements[count++] = Placement(LowestBit(bits) - BitBoard::PAD, y, rot, true);
+			}
+		}
+
+		// rotate like Game::Rotate, the start row is usually open so this rarely fails
+		int nextX = BitBoard::RotateX(type, rot, xPos);
+		int nextRot = (rot + 1) % 4;
+		if (!board.Fits(type, nextRot, nextX, yPos))
+			break;
+		xPos = nextX;
+		rot = nextRot;
+	}
+	return count;
+}
+
+int MoveGen::GenerateAll(const BitBoard& board, int type, Placement* placements)
+{
+	return GenerateAll(board, type, SPAWN_X, SPAWN_Y, 0, placements);
+}
+
+// every placement reachable with any sequence of moves, rotations and soft drops, including spins
+// reach[rot][y] holds every x the piece can be at, grown with shift/and/or until nothing changes
+int MoveGen::GenerateAll(const BitBoard& board, int type, int xPos, int yPos, int rot, Placement* placements)
+{
+	const MoveTables& tables = Tables();
+	RowMask fit[4][BitBoard::HEIGHT + 1];
+	RowMask reach[4][BitBoard::HEIGHT];
+	for (int r = 0; r < 4; r++)
+	{
+		FitMasks(board, type, r, fit[r]);
+		for (int y = 0; y < BitBoard::HEIGHT; y++)
+			reach[r][y] = 0;
+	}
+	reach[rot][yPos] = 1u << (xPos + BitBoard::PAD) & fit[rot][yPos];
+	if (reach[rot][yPos] == 0)
+		return 0;
+
+	// without soft drops the piece can only rotate and shift on the start row, used for the tuck flag
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (int r = 0; r < 4; r++)
+		{
+			RowMask spread = Spread(reach[r][yPos], fit[r][yPos]);
+			RowMask turned = spread & tables.noKick[type][r] & fit[(r + 1) % 4][yPos];
+			for (RowMask bits = spread & ~tables.noKick[type][r]; bits; bits &= bits - 1)
+			{
+				int x = BitBoard::RotateX(type, r, LowestBit(bits) - BitBoard::PAD);
+				turned |= 1u << (x + BitBoard::PAD) & fit[(r + 1) % 4][yPos];
+			}
+			changed |= spread != reach[r][yPos] || (turned & ~reach[(r + 1) % 4][yPos]) != 0;
+			reach[r][yPos] = spread;
+			reach[(r + 1) % 4][yPos] |= turned;
+		}
+	}
+	RowMask hardDrop[4][BitBoard::HEIGHT];
+	for (int r = 0; r < 4; r++)
+	{
+		RowMask falling = reach[r][yPos];
+		for (int y = yPos; y < BitBoard::HEIGHT; y++)
+		{
+			hardDrop[r][y] = falling & ~fit[r][y + 1];
+			falling &= fit[r][y + 1];
+		}
+	}
+
+	// fall and shift top down in each rotation, then rotate in place, repeat until stable
+	changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (int r = 0; r < 4; r++)
+		{
+			RowMask above = 0;
+			for (int y = yPos; y < BitBoard::HEIGHT; y++)
+			{
+				RowMask cur = Spread(reach[r][y] | (above & fit[r][y]), fit[r][y]);
+				changed |= cur != reach[r][y];
+				reach[r][y] = cur;
+				above = cur;
+			}
+		}
+		for (int r = 0; r < 4; r++)
+		{
+			int next = (r + 1) % 4;
+			for (int y = yPos; y < BitBoard::HEIGHT; y++)
+			{
+				RowMask turned = reach[r][y] & tables.noKick[type][r] & fit[next][y];
+				for (RowMask bits = reach[r][y] & ~tables.noKick[type][r]; bits; bits &= bits - 1)
+				{
+					int x = BitBoard::RotateX(type, r, LowestBit(bits) - BitBoard::PAD);
+					turned |= 1u << (x + BitBoard::PAD) & fit[next][y];
+				}
+				if (turned & ~reach[next][y])
+				{
+					reach[next][y] |= turned;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	// final positions can't move down, rotations covering the same cells are reported once
+	int count = 0;
+	RowMask covered[4][BitBoard::HEIGHT + 4] = {};
+	for (int r = 0; r < 4; r++)
+	{
+		int canonical = BitBoard::CanonicalRotation(type, r);
+		int dx, dy;
+		BitBoard::CanonicalOffset(type, r, dx, dy);
+		for (int y = yPos; y < BitBoard::HEIGHT; y++)
+			for (RowMask bits = reach[r][y] & ~fit[r][y + 1]; bits && count < MAX_PLACEMENTS; bits &= bits - 1)
+			{
+				int x = LowestBit(bits) - BitBoard::PAD;
+				int cy = y + dy + 3;
+				RowMask cell = 1u << (x + dx + BitBoard::PAD);
+				if (covered[canonical][cy] & cell)
+					continue;
+				covered[canonical][cy] |= cell;
+				placements[count++] = Placement(x, y, r, !(hardDrop[r][y] >> (x + BitBoard::PAD) & 1));
+			}
+	}
+	return count;
+}
+
+// bit x + PAD is set when the piece fits at (x, y), computed for the whole row at once
+RowMask MoveGen::FitMask(const BitBoard& board, int type, int rot, int y)
+{
+	if (y < 0)
+		return 0;
+	const RowMask* piece = BitBoard::PieceRows(type, rot);
+	RowMask blocked = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (piece[i] == 0)
+			continue;
+		if (y + i >= BitBoard::HEIGHT)
+			return 0;
+		for (RowMask cells = piece[i]; cells; cells &= cells - 1)
+			blocked |= board.rows[y + i] >> LowestBit(cells);
+	}
+	return ~blocked & X_RANGE;
+}
+
+// FitMask for every row plus fit[HEIGHT] = 0, rows well above the stack share one precomputed mask
+void MoveGen::FitMasks(const BitBoard& board, int type, int rot, RowMask* fit)
+{
+	int top = 0;
+	while (top < BitBoard::HEIGHT - 1 && (board.rows[top] & BitBoard::FIELD) == 0)
+		top++;
+
+	const RowMask* piece = BitBoard::PieceRows(type, rot);
+	RowMask open = Tables().openFit[type][rot];
+	for (int y = 0; y < BitBoard::HEIGHT; y++)
+	{
+		if (y + 3 < top)
+		{
+			fit[y] = open;
+			continue;
+		}
+		RowMask blocked = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			if (piece[i] == 0)
+				continue;
+			if (y + i >= BitBoard::HEIGHT)
+			{
+				blocked = ~0u;
+				break;
+			}
+			for (RowMask cells = piece[i]; cells; cells &= cells - 1)
+				blocked |= board.rows[y + i] >> LowestBit(cells);
+		}
+		fit[y] = ~blocked & X_RANGE;
+	}
+	fit[BitBoard::HEIGHT] = 0;
+}
+
+// grow reach sideways through fit until nothing changes
+RowMask MoveGen::Spread(RowMask reach, RowMask fit)
+{
+	reach &= fit;
+	while (true)
+	{
+		RowMask next = (reach | reach << 1 | reach >> 1) & fit;
+		if (next == reach)
+			return reach;
+		reach = next;
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "BitBoard.h"
+
+// enumerate the final placements a piece can reach on a board
+class MoveGen
+{
+public:
+	static const int MAX_PLACEMENTS = 256;
+	static const int SPAWN_X = 3;
+	static const int SPAWN_Y = 0;
+	static int Generate(const BitBoard& board, int type, Placement* placements);
+	static int Generate(const BitBoard& board, int type, int xPos, int yPos, int rot, Placement* placements);
+	static int GenerateAll(const BitBoard& board, int type, Placement* placements);
+	static int GenerateAll(const BitBoard& board, int type, int xPos, int yPos, int rot, Placement* placements);
+	static RowMask FitMask(const BitBoard& board, int type, int rot, int y);
+	static void FitMasks(const BitBoard& board, int type, int rot, RowMask* fit);
+	static RowMask Spread(RowMask reach, RowMask fit);
+};
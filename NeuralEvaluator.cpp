@@ -0,0 +1,348 @@
+#include "NeuralEvaluator.h"
+#include "Evaluator.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NEURAL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+NeuralEvaluator::NeuralEvaluator()
+{
+	weight1.assign(HIDDEN1 * INPUT, 0);
+	bias1.assign(HIDDEN1, 0);
+	weight2.assign(HIDDEN2 * HIDDEN1, 0);
+	bias2.assign(HIDDEN2, 0);
+	weight3.assign(HIDDEN2, 0);
+	bias3 = 0;
+	scale1 = 1;
+	scale2 = 1;
+	outputScale = 1;
+	loaded = false;
+	Rehash();
+}
+
+// the file is MAGIC, INPUT, HIDDEN1, HIDDEN2 as int32, the three scales as float,
+// then weight1, bias1, weight2, bias2, weight3 and bias3, little endian like the machines it runs on
+bool NeuralEvaluator::Load(const string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return false;
+	unsigned int header[4];
+	float scales[3];
+	bool ok = fread(header, sizeof(header), 1, file) == 1
+		&& header[0] == MAGIC && header[1] == INPUT && header[2] == HIDDEN1 && header[3] == HIDDEN2
+		&& fread(scales, sizeof(scales), 1, file) == 1
+		&& fread(weight1.data(), 1, weight1.size(), file) == weight1.size()
+		&& fread(bias1.data(), sizeof(int), bias1.size(), file) == bias1.size()
+		&& fread(weight2.data(), 1, weight2.size(), file) == weight2.size()
+		&& fread(bias2.data(), sizeof(int), bias2.size(), file) == bias2.size()
+		&& fread(weight3.data(), 1, weight3.size(), file) == weight3.size()
+		&& fread(&bias3, sizeof(int), 1, file) == 1;
+	fclose(file);
+	if (!ok)
+		return false;
+	// the padding inputs are always 0 but their weights are cleared too, so the hash doesn't depend on them
+	for (int o = 0; o < HIDDEN1; o++)
+		for (int i = CELLS; i < INPUT; i++)
+			weight1[o * INPUT + i] = 0;
+	scale1 = scales[0];
+	scale2 = scales[1];
+	outputScale = scales[2];
+	loaded = true;
+	Rehash();
+	return true;
+}
+
+bool NeuralEvaluator::Save(const string& path) const
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	unsigned int header[4] = { MAGIC, INPUT, HIDDEN1, HIDDEN2 };
+	float scales[3] = { scale1, scale2, outputScale };
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1
+		&& fwrite(scales, sizeof(scales), 1, file) == 1
+		&& fwrite(weight1.data(), 1, weight1.size(), file) == weight1.size()
+		&& fwrite(bias1.data(), sizeof(int), bias1.size(), file) == bias1.size()
+		&& fwrite(weight2.data(), 1, weight2.size(), file) == weight2.size()
+		&& fwrite(bias2.data(), sizeof(int), bias2.size(), file) == bias2.size()
+		&& fwrite(weight3.data(), 1, weight3.size(), file) == weight3.size()
+		&& fwrite(&bias3, sizeof(int), 1, file) == 1;
+	return fclose(file) == 0 && ok;
+}
+
+static float MaxAbs(const float* values, int count)
+{
+	float result = 0;
+	for (int i = 0; i < count; i++)
+		result = max(result, fabsf(values[i]));
+	return result > 0 ? result : 1;
+}
+
+static signed char ToInt8(float value)
+{
+	return (signed char)max(-127.0f, min(127.0f, nearbyintf(value)));
+}
+
+// float layers of the same shape, with hidden values clipped to 0 .. 1, as a trainer would keep them
+// each layer is scaled so its largest weight is 127, the hidden values become 0 .. ACTIVATION_MAX
+void NeuralEvaluator::Quantize(const float* w1, const float* b1, const float* w2, const float* b2, const float* w3, float b3)
+{
+	float s1 = ACTIVATION_MAX / MaxAbs(w1, HIDDEN1 * INPUT);
+	float s2 = ACTIVATION_MAX / MaxAbs(w2, HIDDEN2 * HIDDEN1);
+	float s3 = ACTIVATION_MAX / MaxAbs(w3, HIDDEN2);
+	for (int i = 0; i < HIDDEN1 * INPUT; i++)
+		weight1[i] = i % INPUT < CELLS ? ToInt8(w1[i] * s1) : 0;
+	for (int i = 0; i < HIDDEN1; i++)
+		bias1[i] = (int)nearbyintf(b1[i] * s1);
+	for (int i = 0; i < HIDDEN2 * HIDDEN1; i++)
+		weight2[i] = ToInt8(w2[i] * s2);
+	for (int i = 0; i < HIDDEN2; i++)
+		bias2[i] = (int)nearbyintf(b2[i] * s2 * ACTIVATION_MAX);
+	for (int i = 0; i < HIDDEN2; i++)
+		weight3[i] = ToInt8(w3[i] * s3);
+	bias3 = (int)nearbyintf(b3 * s3 * ACTIVATION_MAX);
+	// inputs are 0 or 1, hidden inputs are ACTIVATION_MAX times their float value
+	scale1 = ACTIVATION_MAX / s1;
+	scale2 = 1 / s2;
+	outputScale = 1 / (s3 * ACTIVATION_MAX);
+	loaded = true;
+	Rehash();
+}
+
+bool NeuralEvaluator::IsLoaded() const
+{
+	return loaded;
+}
+
+// hash of the weights, mixed into EvalWeights::Key so cached scores of another network never match
+HashKey NeuralEvaluator::Key() const
+{
+	return key;
+}
+
+void NeuralEvaluator::Rehash()
+{
+	key = BitBoard::Mix(7ULL << 56);
+	const vector<signed char>* layers[3] = { &weight1, &weight2, &weight3 };
+	for (const vector<signed char>* layer : layers)
+		for (size_t i = 0; i < layer->size(); i += 8)
+		{
+			HashKey word = 0;
+			memcpy(&word, layer->data() + i, min((size_t)8, layer->size() - i));
+			key = BitBoard::Mix(key ^ word);
+		}
+	const vector<int>* biases[2] = { &bias1, &bias2 };
+	for (const vector<int>* bias : biases)
+		for (int value : *bias)
+			key = BitBoard::Mix(key ^ (unsigned int)value);
+	float scales[3] = { scale1, scale2, outputScale };
+	unsigned int bits[3];
+	memcpy(bits, scales, sizeof(bits));
+	key = BitBoard::Mix(key ^ (unsigned int)bias3 ^ (HashKey)bits[0] << 32);
+	key = BitBoard::Mix(key ^ bits[1] ^ (HashKey)bits[2] << 32);
+}
+
+static unsigned char Activation(int sum, float scale)
+{
+	return (unsigned char)max(0, min(NeuralEvaluator::ACTIVATION_MAX, (int)nearbyintf(sum * scale)));
+}
+
+#ifdef NEURAL_X86
+// bit i of bits to byte i of input, as 0 or 1, 32 at a time
+AVX2_TARGET static void SpreadAvx2(const unsigned long long* bits, unsigned char* input)
+{
+	const __m256i byteOf = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+	const __m256i bitOf = _mm256_set1_epi64x(0x8040201008040201LL);
+	const __m256i one = _mm256_set1_epi8(1);
+	for (int i = 0; i < NeuralEvaluator::INPUT / 32; i++)
+	{
+		unsigned int half = (unsigned int)(bits[i / 2] >> (i % 2 * 32));
+		__m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32((int)half), byteOf);
+		_mm256_storeu_si256((__m256i*)(input + i * 32), _mm256_min_epu8(_mm256_and_si256(bytes, bitOf), one));
+	}
+}
+
+// the sums of a, b, c and d in the four lanes
+AVX2_TARGET static inline __m128i Sum4(__m256i a, __m256i b, __m256i c, __m256i d)
+{
+	__m256i ab = _mm256_hadd_epi32(a, b);
+	__m256i cd = _mm256_hadd_epi32(c, d);
+	__m256i abcd = _mm256_hadd_epi32(ab, cd);
+	return _mm_add_epi32(_mm256_castsi256_si128(abcd), _mm256_extracti128_si256(abcd, 1));
+}
+
+// one weight row against the inputs of all BATCH boards, every weight vector is loaded once for the four of them
+AVX2_TARGET static inline __m128i Dot4(const unsigned char* input, int size, int start, const signed char* weight)
+{
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i sum[NeuralEvaluator::BATCH];
+	for (int b = 0; b < NeuralEvaluator::BATCH; b++)
+		sum[b] = _mm256_setzero_si256();
+	for (int i = start; i < size; i += 32)
+	{
+		__m256i w = _mm256_loadu_si256((const __m256i*)(weight + i));
+		for (int b = 0; b < NeuralEvaluator::BATCH; b++)
+		{
+			// unsigned inputs times signed weights, pairs added in 16 bits and then in 32
+			__m256i pairs = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(input + b * size + i)), w);
+			sum[b] = _mm256_add_epi32(sum[b], _mm256_madd_epi16(pairs, ones));
+		}
+	}
+	return Sum4(sum[0], sum[1], sum[2], sum[3]);
+}
+
+AVX2_TARGET static void HiddenAvx2(const unsigned char* input, int size, int start, const signed char* weight, const int* bias, int outSize, float scale, unsigned char* output)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i top = _mm_set1_epi32(NeuralEvaluator::ACTIVATION_MAX);
+	for (int o = 0; o < outSize; o++)
+	{
+		__m128i sum = _mm_add_epi32(Dot4(input, size, start, weight + o * size), _mm_set1_epi32(bias[o]));
+		// rounds to nearest even like nearbyintf in the scalar version
+		__m128i value = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum), _mm_set1_ps(scale)));
+		value = _mm_min_epi32(_mm_max_epi32(value, zero), top);
+		alignas(16) int lanes[NeuralEvaluator::BATCH];
+		_mm_store_si128((__m128i*)lanes, value);
+		for (int b = 0; b < NeuralEvaluator::BATCH; b++)
+			output[b * outSize + o] = (unsigned char)lanes[b];
+	}
+}
+
+AVX2_TARGET static void OutputAvx2(const unsigned char* input, const signed char* weight, int bias, float scale, float* values)
+{
+	alignas(16) int lanes[NeuralEvaluator::BATCH];
+	_mm_store_si128((__m128i*)lanes, _mm_add_epi32(Dot4(input, NeuralEvaluator::HIDDEN2, 0, weight), _mm_set1_epi32(bias)));
+	for (int b = 0; b < NeuralEvaluator::BATCH; b++)
+		values[b] = lanes[b] * scale;
+}
+#endif
+
+// the bytes of a 4 cell nibble, lowest cell first
+static const unsigned char NIBBLE[16][4] = {
+	{ 0, 0, 0, 0 }, { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 1, 1, 0, 0 },
+	{ 0, 0, 1, 0 }, { 1, 0, 1, 0 }, { 0, 1, 1, 0 }, { 1, 1, 1, 0 },
+	{ 0, 0, 0, 1 }, { 1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 1, 1, 0, 1 },
+	{ 0, 0, 1, 1 }, { 1, 0, 1, 1 }, { 0, 1, 1, 1 }, { 1, 1, 1, 1 }
+};
+
+// one byte per cell row by row from the top
+// the inputs are packed as bits first and every 32 bits are spread to bytes at once
+void NeuralEvaluator::Encode(const BitBoard& board, unsigned char* input)
+{
+	static const bool avx2 = Evaluator::HasAvx2();
+	const RowMask columns = (1u << COLUMNS) - 1;
+	unsigned long long bits[INPUT / 64 + 1] = {};
+	// rows are shifted into one word in a register, a full word is written out and the rest of the row starts the next
+	unsigned long long word = 0;
+	int used = 0, wordNum = 0;
+	for (int y = 0; y < ROWS; y++)
+	{
+		unsigned long long row = board.rows[y] >> (BitBoard::PAD + 1) & columns;
+		word |= row << used;
+		used += COLUMNS;
+		if (used >= 64)
+		{
+			bits[wordNum++] = word;
+			used -= 64;
+			word = used ? row >> (COLUMNS - used) : 0;
+		}
+	}
+	bits[wordNum] = word;
+
+#ifdef NEURAL_X86
+	if (avx2)
+	{
+		SpreadAvx2(bits, input);
+		return;
+	}
+#endif
+	for (int i = 0; i < INPUT / 32; i++)
+	{
+		unsigned int half = (unsigned int)(bits[i / 2] >> (i % 2 * 32));
+		for (int x = 0; x < 32; x += 4)
+			memcpy(input + i * 32 + x, NIBBLE[(half >> x) & 15], 4);
+	}
+}
+
+static void HiddenScalar(const unsigned char* input, int size, int start, const signed char* weight, const int* bias, int outSize, float scale, unsigned char* output)
+{
+	for (int b = 0; b < NeuralEvaluator::BATCH; b++)
+		for (int o = 0; o < outSize; o++)
+		{
+			int sum = bias[o];
+			for (int i = start; i < size; i++)
+				sum += input[b * size + i] * weight[o * size + i];
+			output[b * outSize + o] = Activation(sum, scale);
+		}
+}
+
+// BATCH encoded inputs to BATCH values, with AVX2 when the cpu has it, both give the same results
+// inputs before start are 0 in every board, they are the empty rows above the stacks and are skipped
+void NeuralEvaluator::Forward(const unsigned char* input, int start, float* values) const
+{
+	static const bool avx2 = Evaluator::HasAvx2();
+	alignas(32) unsigned char hidden1[BATCH * HIDDEN1];
+	alignas(32) unsigned char hidden2[BATCH * HIDDEN2];
+#ifdef NEURAL_X86
+	if (avx2)
+	{
+		HiddenAvx2(input, INPUT, start, weight1.data(), bias1.data(), HIDDEN1, scale1, hidden1);
+		HiddenAvx2(hidden1, HIDDEN1, 0, weight2.data(), bias2.data(), HIDDEN2, scale2, hidden2);
+		OutputAvx2(hidden2, weight3.data(), bias3, outputScale, values);
+		return;
+	}
+#endif
+	HiddenScalar(input, INPUT, start, weight1.data(), bias1.data(), HIDDEN1, scale1, hidden1);
+	HiddenScalar(hidden1, HIDDEN1, 0, weight2.data(), bias2.data(), HIDDEN2, scale2, hidden2);
+	for (int b = 0; b < BATCH; b++)
+	{
+		int sum = bias3;
+		for (int i = 0; i < HIDDEN2; i++)
+			sum += hidden2[b * HIDDEN2 + i] * weight3[i];
+		values[b] = sum * outputScale;
+	}
+}
+
+float NeuralEvaluator::Evaluate(const BitBoard& board) const
+{
+	const BitBoard* boards[1] = { &board };
+	float value;
+	EvaluateBatch(boards, 1, &value);
+	return value;
+}
+
+// BATCH boards at a time
+void NeuralEvaluator::EvaluateBatch(const BitBoard* const* boards, int count, float* values) const
+{
+	alignas(32) unsigned char input[BATCH * INPUT];
+	float batchValues[BATCH];
+	for (int start = 0; start < count; start += BATCH)
+	{
+		int n = min(BATCH, count - start);
+		int top = ROWS;
+		for (int b = 0; b < n; b++)
+		{
+			const BitBoard& board = *boards[start + b];
+			Encode(board, input + b * INPUT);
+			for (int y = 0; y < top; y++)
+				if (board.rows[y] & BitBoard::FIELD)
+					top = y;
+		}
+		// a short batch runs on empty inputs
+		memset(input + n * INPUT, 0, (BATCH - n) * INPUT);
+		Forward(input, top * COLUMNS / 32 * 32, batchValues);
+		for (int b = 0; b < n; b++)
+			values[start + b] = batchValues[b];
+	}
+}
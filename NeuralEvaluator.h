@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "BitBoard.h"
+
+using namespace std;
+
+// small int8 network that scores a board, used by Evaluator in place of the feature weights
+// the input is one byte per playfield cell, then two clipped relu layers and one output
+// the board alone, since the searches cache scores by board and pieces past the preview are unknown anyway
+// every layer is a row of int8 weights per output, an int32 bias and a float scale back to the next layer
+class NeuralEvaluator
+{
+public:
+	static const int COLUMNS = BitBoard::WIDTH - 2;
+	static const int ROWS = BitBoard::HEIGHT - 1;
+	static const int CELLS = ROWS * COLUMNS;
+	// padded to whole 32 byte vectors, the padding is always 0
+	static const int INPUT = (CELLS + 31) / 32 * 32;
+	static const int HIDDEN1 = 64;
+	static const int HIDDEN2 = 32;
+	// hidden values are clipped to 0 .. ACTIVATION_MAX, so a pair of products still fits in 16 bits
+	static const int ACTIVATION_MAX = 127;
+	// boards run through the kernel together, sharing every weight load
+	static const int BATCH = 4;
+	// "TNN1" at the start of a weight file
+	static const unsigned int MAGIC = 0x314E4E54;
+private:
+	vector<signed char> weight1;
+	vector<int> bias1;
+	vector<signed char> weight2;
+	vector<int> bias2;
+	vector<signed char> weight3;
+	int bias3;
+	float scale1;
+	float scale2;
+	float outputScale;
+	HashKey key;
+	bool loaded;
+public:
+	NeuralEvaluator();
+	bool Load(const string& path);
+	bool Save(const string& path) const;
+	void Quantize(const float* w1, const float* b1, const float* w2, const float* b2, const float* w3, float b3);
+	bool IsLoaded() const;
+	HashKey Key() const;
+	float Evaluate(const BitBoard& board) const;
+	void EvaluateBatch(const BitBoard* const* boards, int count, float* values) const;
+	static void Encode(const BitBoard& board, unsigned char* input);
+private:
+	void Forward(const unsigned char* input, int start, float* values) const;
+	void Rehash();
+};
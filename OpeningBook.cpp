@@ -0,0 +1,207 @@
+#include "OpeningBook.h"
+#include "Expectimax.h"
+#include <cstdio>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(OpeningBook::Record) == 20, "the book file depends on the record layout");
+
+OpeningBook::OpeningBook()
+{
+	records = nullptr;
+	recordNum = 0;
+	view = nullptr;
+	viewSize = 0;
+	mapping = nullptr;
+}
+
+OpeningBook::~OpeningBook()
+{
+	Close();
+}
+
+// map the file read only, the pages are shared by every process using the same book
+bool OpeningBook::Open(const string& path)
+{
+	Close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	HANDLE fileMapping = GetFileSizeEx(file, &size) && size.QuadPart > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	// the mapping keeps the file open
+	CloseHandle(file);
+	if (fileMapping == NULL)
+		return false;
+	view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(fileMapping);
+		return false;
+	}
+	mapping = fileMapping;
+	viewSize = (size_t)size.QuadPart;
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat info;
+	void* address = fstat(file, &info) == 0 && info.st_size > 0 ? mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, file, 0) : MAP_FAILED;
+	close(file);
+	if (address == MAP_FAILED)
+		return false;
+	view = address;
+	viewSize = (size_t)info.st_size;
+#endif
+
+	const unsigned int* header = (const unsigned int*)view;
+	if (viewSize < 2 * sizeof(unsigned int) || header[0] != MAGIC || viewSize < 2 * sizeof(unsigned int) + header[1] * sizeof(Record))
+	{
+		Close();
+		return false;
+	}
+	recordNum = (int)header[1];
+	records = (const Record*)(header + 2);
+	return true;
+}
+
+void OpeningBook::Close()
+{
+	if (view)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(view);
+		CloseHandle((HANDLE)mapping);
+#else
+		munmap((void*)view, viewSize);
+#endif
+	}
+	records = nullptr;
+	recordNum = 0;
+	view = nullptr;
+	viewSize = 0;
+	mapping = nullptr;
+}
+
+bool OpeningBook::IsOpen() const
+{
+	return records != nullptr;
+}
+
+// shown is every piece drawn in the game so far, the current piece is shown[shownNum - 2]
+// the smallest order that starts with the shown pieces of the first bag is found by binary search,
+// and its moves are replayed to check the board is the one the book expects
+bool OpeningBook::Lookup(const BitBoard& board, const int* shown, int shownNum, Placement& move) const
+{
+	int step = shownNum - 2;
+	if (records == nullptr || step < 0 || step >= PIECES)
+		return false;
+	int order[PIECES];
+	int known = min(shownNum, PIECES);
+	int used = 0;
+	for (int i = 0; i < known; i++)
+	{
+		if (shown[i] < 0 || shown[i] >= 7 || (used & (1 << shown[i])))
+			return false;
+		used |= 1 << shown[i];
+		order[i] = shown[i];
+	}
+	for (int type = 0, i = known; type < 7; type++)
+		if (!(used & (1 << type)))
+			order[i++] = type;
+
+	unsigned int key = OrderKey(order, PIECES);
+	const Record* found = lower_bound(records, records + recordNum, key, [](const Record& record, unsigned int k) { return record.order < k; });
+	if (found == records + recordNum || found->order != key)
+		return false;
+
+	BitBoard expected;
+	for (int i = 0; i < step; i++)
+		expected.Place(order[i], UnpackMove(found->moves[i]));
+	if (!(expected == board))
+		return false;
+	move = UnpackMove(found->moves[step]);
+	return true;
+}
+
+// offline: expectimax for every piece of every order with millisecond per move, like the bot sees the game
+// a move is searched once per shown prefix and shared by all orders starting with it
+bool OpeningBook::Build(const string& path, int millisecond)
+{
+	ThreadPool pool;
+	Expectimax expectimax(pool);
+	expectimax.allowTucks = true;
+	expectimax.cleanFitsOnly = true;
+	EvalWeights weights;
+	atomic<bool> stop(false);
+	unordered_map<unsigned int, unsigned short> searched;
+
+	vector<Record> book;
+	int order[PIECES] = { 0, 1, 2, 3, 4, 5, 6 };
+	do
+	{
+		Record record = {};
+		record.order = OrderKey(order, PIECES);
+		BitBoard board;
+		for (int step = 0; step < PIECES; step++)
+		{
+			int known = min(step + 2, PIECES);
+			// the shown pieces and the step, the last two steps both know the whole bag
+			unsigned int prefix = OrderKey(order, known) | (unsigned int)step << 24;
+			auto cached = searched.find(prefix);
+			if (cached == searched.end())
+			{
+				int bag = 0;
+				for (int i = known; i < PIECES; i++)
+					bag |= 1 << order[i];
+				Placement best;
+				if (expectimax.Search(board, order + step, known - step, bag ? bag : Expectimax::FULL_BAG, millisecond / 1000.0, weights, stop, best) == 0)
+					return false;
+				cached = searched.insert(make_pair(prefix, PackMove(best))).first;
+				printf("\r%d searches  %d / %d orders   ", (int)searched.size(), (int)book.size(), ORDERS);
+				fflush(stdout);
+			}
+			record.moves[step] = cached->second;
+			board.Place(order[step], UnpackMove(cached->second));
+		}
+		book.push_back(record);
+	} while (next_permutation(order, order + PIECES));
+	printf("\n");
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	unsigned int header[2] = { MAGIC, (unsigned int)book.size() };
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(book.data(), sizeof(Record), book.size(), file) == book.size();
+	return fclose(file) == 0 && ok;
+}
+
+unsigned int OpeningBook::OrderKey(const int* pieces, int pieceNum)
+{
+	unsigned int key = 0;
+	for (int i = 0; i < pieceNum; i++)
+		key |= (unsigned int)pieces[i] << (3 * (PIECES - 1 - i));
+	return key;
+}
+
+unsigned short OpeningBook::PackMove(const Placement& move)
+{
+	return (unsigned short)((move.x + BitBoard::PAD) | move.rotation << 5 | move.y << 7 | (move.tuck ? 1 : 0) << 12);
+}
+
+Placement OpeningBook::UnpackMove(unsigned short packed)
+{
+	return Placement((packed & 31) - BitBoard::PAD, packed >> 7 & 31, packed >> 5 & 3, (packed >> 12 & 1) != 0);
+}
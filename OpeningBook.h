@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include "BitBoard.h"
+
+using namespace std;
+
+// placements for the first bag, one record per order of the 7 pieces, sorted by order
+// the move for a piece only depends on the pieces shown so far (current and next), so every order
+// that starts the same way has the same moves up to there and a lookup only needs what has been shown
+class OpeningBook
+{
+public:
+	static const int PIECES = 7;
+	static const int ORDERS = 5040;
+	// "TBK1" at the start of a book file
+	static const unsigned int MAGIC = 0x314B4254;
+	static const int DEFAULT_MILLISECOND = 50;
+	struct Record
+	{
+		// piece types in order, 3 bits each with the first piece highest, so records sort like the orders
+		unsigned int order;
+		// x + PAD, rotation, y and tuck packed in 13 bits
+		unsigned short moves[PIECES];
+		unsigned short unused;
+	};
+private:
+	const Record* records;
+	int recordNum;
+	// the mapping of the whole file, records point into it
+	const void* view;
+	size_t viewSize;
+	void* mapping;
+public:
+	OpeningBook();
+	~OpeningBook();
+	bool Open(const string& path);
+	void Close();
+	bool IsOpen() const;
+	bool Lookup(const BitBoard& board, const int* shown, int shownNum, Placement& move) const;
+	static bool Build(const string& path, int millisecond);
+	static unsigned int OrderKey(const int* pieces, int pieceNum);
+	static unsigned short PackMove(const Placement& move);
+	static Placement UnpackMove(unsigned short packed);
+};
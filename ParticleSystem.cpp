@@ -0,0 +1,138 @@
+#include "ParticleSystem.h"
+#include "Game.h"
+
+static const float GRAVITY = 30.0f;
+static const float MAX_LIFE = 0.8f;
+static const float PARTICLE_SIZE = 0.5f;
+
+static float RandomFloat(float low, float high)
+{
+	return low + (high - low) * rand() / (float)RAND_MAX;
+}
+
+ParticleSystem::ParticleSystem()
+{
+	bucketNum = 0;
+	lastCounter = SDL_GetPerformanceCounter();
+	usedCounter = 0;
+	emitLimit = MAX_EMIT_PER_FRAME;
+	Clear();
+}
+
+void ParticleSystem::Clear()
+{
+	count = 0;
+	emitted = 0;
+}
+
+// spawn up to n particles around the position (in cells), dropped once the pool or the frame limit is full
+void ParticleSystem::Emit(float xPos, float yPos, int n, const Color& color, float speed)
+{
+	n = min(n, min(emitLimit - emitted, MAX_PARTICLES - count));
+	if (n <= 0)
+		return;
+
+	unsigned char b = (unsigned char)FindBucket(color);
+	for (int i = count; i < count + n; i++)
+	{
+		x[i] = xPos + RandomFloat(0, 1);
+		y[i] = yPos + RandomFloat(0, 1);
+		vx[i] = RandomFloat(-speed, speed);
+		vy[i] = RandomFloat(-speed, speed * 0.25f);
+		life[i] = RandomFloat(MAX_LIFE / 2, MAX_LIFE);
+		bucket[i] = b;
+	}
+	count += n;
+	emitted += n;
+}
+
+void ParticleSystem::Update()
+{
+	Uint64 start = SDL_GetPerformanceCounter();
+	float dt = min((float)(start - lastCounter) / SDL_GetPerformanceFrequency(), 0.1f);
+	lastCounter = start;
+
+	// keep the particle work within its share of the frame, emit less next frame if it went over
+	if (usedCounter * 1000000 / SDL_GetPerformanceFrequency() > BUDGET_MICROSECOND)
+		emitLimit = max(16, emitLimit / 2);
+	else
+		emitLimit = min(MAX_EMIT_PER_FRAME, emitLimit + 16);
+	emitted = 0;
+
+	for (int i = 0; i < count; i++)
+		vy[i] += GRAVITY * dt;
+	for (int i = 0; i < count; i++)
+	{
+		x[i] += vx[i] * dt;
+		y[i] += vy[i] * dt;
+		life[i] -= dt;
+	}
+
+	// remove dead particles by moving the last one into the hole
+	for (int i = 0; i < count;)
+		if (life[i] <= 0)
+		{
+			count -= 1;
+			x[i] = x[count];
+			y[i] = y[count];
+			vx[i] = vx[count];
+			vy[i] = vy[count];
+			life[i] = life[count];
+			bucket[i] = bucket[count];
+		}
+		else
+			i++;
+
+	usedCounter = SDL_GetPerformanceCounter() - start;
+}
+
+// one fill call per color, particles shrink as they die, return the number of draw calls
+int ParticleSystem::Draw(SDL_Renderer* renderer, float scale, float offsetX, float offsetY)
+{
+	if (count == 0)
+		return 0;
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	int bucketStart[COLOR_BUCKETS + 1] = { 0 };
+	for (int i = 0; i < count; i++)
+		bucketStart[bucket[i] + 1] += 1;
+	for (int b = 0; b < COLOR_BUCKETS; b++)
+		bucketStart[b + 1] += bucketStart[b];
+
+	int bucketEnd[COLOR_BUCKETS];
+	copy(bucketStart, bucketStart + COLOR_BUCKETS, bucketEnd);
+	for (int i = 0; i < count; i++)
+	{
+		float size = PARTICLE_SIZE * scale * life[i] / MAX_LIFE;
+		rects[bucketEnd[bucket[i]]++] = { offsetX + x[i] * scale - size / 2, offsetY + y[i] * scale - size / 2, size, size };
+	}
+
+	int calls = 0;
+	for (int b = 0; b < bucketNum; b++)
+		if (bucketStart[b + 1] > bucketStart[b])
+		{
+			SDL_SetRenderDrawColor(renderer, bucketColor[b].r, bucketColor[b].g, bucketColor[b].b, bucketColor[b].a);
+			SDL_RenderFillRectsF(renderer, rects + bucketStart[b], bucketStart[b + 1] - bucketStart[b]);
+			calls += 1;
+		}
+
+	usedCounter += SDL_GetPerformanceCounter() - start;
+	return calls;
+}
+
+int ParticleSystem::Count()
+{
+	return count;
+}
+
+// colors are registered on first use, the last bucket is shared once all are taken
+int ParticleSystem::FindBucket(const Color& color)
+{
+	for (int b = 0; b < bucketNum; b++)
+		if (bucketColor[b].r == color.r && bucketColor[b].g == color.g && bucketColor[b].b == color.b)
+			return b;
+	if (bucketNum == COLOR_BUCKETS)
+		return COLOR_BUCKETS - 1;
+	bucketColor[bucketNum] = { (Uint8)color.r, (Uint8)color.g, (Uint8)color.b, (Uint8)color.a };
+	return bucketNum++;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <SDL.h>
+
+struct Color;
+
+// fixed-capacity particle pool, stored as structure of arrays so update is a few flat loops
+class ParticleSystem
+{
+public:
+	static const int MAX_PARTICLES = 1024;
+	static const int MAX_EMIT_PER_FRAME = 256;
+	static const int COLOR_BUCKETS = 8;
+	static const int BUDGET_MICROSECOND = 1000;
+private:
+	int count;
+	int emitted;
+	int emitLimit;
+	float x[MAX_PARTICLES];
+	float y[MAX_PARTICLES];
+	float vx[MAX_PARTICLES];
+	float vy[MAX_PARTICLES];
+	float life[MAX_PARTICLES];
+	unsigned char bucket[MAX_PARTICLES];
+	SDL_Color bucketColor[COLOR_BUCKETS];
+	int bucketNum;
+	// scratch space for the batched draw, sorted by color
+	SDL_FRect rects[MAX_PARTICLES];
+	Uint64 lastCounter;
+	Uint64 usedCounter;
+public:
+	ParticleSystem();
+	void Clear();
+	void Emit(float xPos, float yPos, int n, const Color& color, float speed);
+	void Update();
+	int Draw(SDL_Renderer* renderer, float scale, float offsetX, float offsetY);
+	int Count();
+private:
+	int FindBucket(const Color& color);
+};
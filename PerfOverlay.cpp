@@ -0,0 +1,193 @@
+#include "PerfOverlay.h"
+#include <cstdio>
+#include <algorithm>
+
+using namespace std;
+
+// graph size in text lines
+static const int GRAPH_WIDTH = 16;
+static const int GRAPH_HEIGHT = 3;
+static const float GRAPH_MAX_MS = 33.3f;
+
+const char* PerfOverlay::PHASE_NAME[PHASE_NUM] = {
+	"events",
+	"simulation",
+	"text",
+	"board",
+	"present"
+};
+
+PerfOverlay::PerfOverlay()
+{
+	visible = false;
+	frequency = SDL_GetPerformanceFrequency();
+	frameStart = SDL_GetPerformanceCounter();
+	for (int i = 0; i < PHASE_NUM; i++)
+	{
+		phaseStart[i] = 0;
+		phaseCounter[i] = 0;
+		phaseTime[i] = 0;
+	}
+	for (int i = 0; i < HISTORY; i++)
+		frameTime[i] = 0;
+	historyPos = 0;
+	drawCalls = 0;
+	textures = 0;
+	lastDrawCalls = 0;
+	lastTextures = 0;
+	atlas = nullptr;
+}
+
+// must be called before the renderer is destroyed
+void PerfOverlay::Free()
+{
+	if (atlas)
+	{
+		SDL_DestroyTexture(atlas);
+		atlas = nullptr;
+	}
+}
+
+void PerfOverlay::Toggle()
+{
+	visible = !visible;
+}
+
+bool PerfOverlay::IsVisible()
+{
+	return visible;
+}
+
+// close the previous frame and start a new one
+void PerfOverlay::BeginFrame()
+{
+	Uint64 now = SDL_GetPerformanceCounter();
+	frameTime[historyPos] = (float)(now - frameStart) * 1000 / frequency;
+	historyPos = (historyPos + 1) % HISTORY;
+	frameStart = now;
+
+	// smooth the phase timings so the numbers are readable
+	for (int i = 0; i < PHASE_NUM; i++)
+	{
+		phaseTime[i] = phaseTime[i] * 0.9f + (float)phaseCounter[i] * 1000 / frequency * 0.1f;
+		phaseCounter[i] = 0;
+	}
+	lastDrawCalls = drawCalls;
+	lastTextures = textures;
+	drawCalls = 0;
+	textures = 0;
+}
+
+void PerfOverlay::Begin(int phase)
+{
+	phaseStart[phase] = SDL_GetPerformanceCounter();
+}
+
+void PerfOverlay::End(int phase)
+{
+	phaseCounter[phase] += SDL_GetPerformanceCounter() - phaseStart[phase];
+}
+
+void PerfOverlay::CountDrawCall(int n)
+{
+	drawCalls += n;
+}
+
+void PerfOverlay::CountTexture(int n)
+{
+	textures += n;
+}
+
+void PerfOverlay::Draw(SDL_Renderer* renderer, TTF_Font* font, int xPos, int yPos, int lineHeight)
+{
+	if (!visible)
+		return;
+	if (atlas == nullptr)
+		BuildAtlas(renderer, font);
+
+	// frame-time graph, oldest sample on the left
+	int graphWidth = GRAPH_WIDTH * lineHeight;
+	int graphHeight = GRAPH_HEIGHT * lineHeight;
+	SDL_SetRenderDrawColor(renderer, 40, 40, 40, 255);
+	SDL_Rect background{ xPos, yPos, graphWidth, graphHeight };
+	SDL_RenderFillRect(renderer, &background);
+	for (int i = 0; i < HISTORY; i++)
+	{
+		float ms = min(frameTime[(historyPos + i) % HISTORY], GRAPH_MAX_MS);
+		graph[i] = { xPos + (float)i * graphWidth / (HISTORY - 1), yPos + graphHeight - ms * graphHeight / GRAPH_MAX_MS };
+	}
+	SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
+	SDL_RenderDrawLinesF(renderer, graph, HISTORY);
+	// 60 fps line
+	SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+	int target = yPos + graphHeight - (int)(1000.0f / 60 * graphHeight / GRAPH_MAX_MS);
+	SDL_RenderDrawLine(renderer, xPos, target, xPos + graphWidth, target);
+
+	if (atlas == nullptr)
+		return;
+
+	char text[64];
+	int y = yPos + graphHeight + 2;
+	float last = frameTime[(historyPos + HISTORY - 1) % HISTORY];
+	snprintf(text, sizeof(text), "frame %5.2f ms", last);
+	y += DrawText(renderer, text, xPos, y, lineHeight);
+	for (int i = 0; i < PHASE_NUM; i++)
+	{
+		snprintf(text, sizeof(text), "%-10s %5.2f ms", PHASE_NAME[i], phaseTime[i]);
+		y += DrawText(renderer, text, xPos, y, lineHeight);
+	}
+	snprintf(text, sizeof(text), "draws %d  textures %d", lastDrawCalls, lastTextures);
+	DrawText(renderer, text, xPos, y, lineHeight);
+}
+
+void PerfOverlay::BuildAtlas(SDL_Renderer* renderer, TTF_Font* font)
+{
+	if (font == nullptr)
+		return;
+
+	SDL_Surface* glyphSurf[LAST_GLYPH - FIRST_GLYPH + 1];
+	int width = 0;
+	int height = 0;
+	for (int c = FIRST_GLYPH; c <= LAST_GLYPH; c++)
+	{
+		glyphSurf[c - FIRST_GLYPH] = TTF_RenderGlyph_Blended(font, (Uint16)c, { 255, 255, 255, 255 });
+		if (glyphSurf[c - FIRST_GLYPH])
+		{
+			width += glyphSurf[c - FIRST_GLYPH]->w;
+			height = max(height, glyphSurf[c - FIRST_GLYPH]->h);
+		}
+	}
+
+	SDL_Surface* atlasSurf = SDL_CreateRGBSurfaceWithFormat(0, max(width, 1), max(height, 1), 32, SDL_PIXELFORMAT_RGBA32);
+	int x = 0;
+	for (int c = FIRST_GLYPH; c <= LAST_GLYPH; c++)
+	{
+		SDL_Surface* surf = glyphSurf[c - FIRST_GLYPH];
+		glyph[c - FIRST_GLYPH] = { x, 0, surf ? surf->w : 0, surf ? surf->h : 0 };
+		if (surf)
+		{
+			SDL_SetSurfaceBlendMode(surf, SDL_BLENDMODE_NONE);
+			SDL_BlitSurface(surf, NULL, atlasSurf, &glyph[c - FIRST_GLYPH]);
+			x += surf->w;
+			SDL_FreeSurface(surf);
+		}
+	}
+
+	atlas = SDL_CreateTextureFromSurface(renderer, atlasSurf);
+	SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
+	SDL_FreeSurface(atlasSurf);
+}
+
+// draw a line of text from the atlas scaled to lineHeight and return its height
+int PerfOverlay::DrawText(SDL_Renderer* renderer, const char* text, int xPos, int yPos, int lineHeight)
+{
+	int x = xPos;
+	for (const char* c = text; *c; c++)
+	{
+		int i = (*c >= FIRST_GLYPH && *c <= LAST_GLYPH) ? *c - FIRST_GLYPH : '?' - FIRST_GLYPH;
+		SDL_Rect dst{ x, yPos, glyph[i].h > 0 ? glyph[i].w * lineHeight / glyph[i].h : 0, lineHeight };
+		SDL_RenderCopy(renderer, atlas, &glyph[i], &dst);
+		x += dst.w;
+	}
+	return lineHeight;
+}
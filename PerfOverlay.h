@@ -0,0 +1,50 @@
+#pragma once
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+// toggleable HUD with a frame-time graph, per-phase timings and per-frame draw counters
+class PerfOverlay
+{
+public:
+	static const int PHASE_EVENTS = 0;
+	static const int PHASE_SIMULATION = 1;
+	static const int PHASE_TEXT = 2;
+	static const int PHASE_BOARD = 3;
+	static const int PHASE_PRESENT = 4;
+	static const int PHASE_NUM = 5;
+	static const int HISTORY = 120;
+	static const int FIRST_GLYPH = 32;
+	static const int LAST_GLYPH = 126;
+	static const char* PHASE_NAME[PHASE_NUM];
+private:
+	bool visible;
+	Uint64 frequency;
+	Uint64 frameStart;
+	Uint64 phaseStart[PHASE_NUM];
+	Uint64 phaseCounter[PHASE_NUM];
+	float phaseTime[PHASE_NUM];
+	float frameTime[HISTORY];
+	int historyPos;
+	int drawCalls;
+	int textures;
+	int lastDrawCalls;
+	int lastTextures;
+	// every printable glyph is rasterized once into a single texture
+	SDL_Texture* atlas;
+	SDL_Rect glyph[LAST_GLYPH - FIRST_GLYPH + 1];
+	SDL_FPoint graph[HISTORY];
+public:
+	PerfOverlay();
+	void Free();
+	void Toggle();
+	bool IsVisible();
+	void BeginFrame();
+	void Begin(int phase);
+	void End(int phase);
+	void CountDrawCall(int n = 1);
+	void CountTexture(int n = 1);
+	void Draw(SDL_Renderer* renderer, TTF_Font* font, int xPos, int yPos, int lineHeight);
+private:
+	void BuildAtlas(SDL_Renderer* renderer, TTF_Font* font);
+	int DrawText(SDL_Renderer* renderer, const char* text, int xPos, int yPos, int lineHeight);
+};
@@ -0,0 +1,160 @@
+#include "PerfectClear.h"
+
+PerfectClear::PerfectClear(ThreadPool& threadPool) : pool(threadPool), table(TABLE_SIZE_LOG2)
+{
+	nodes = 0;
+	cancel = nullptr;
+}
+
+// chance of a perfect clear with queue[0] placed at best, 0 if there is none or the search was stopped
+// the placements of the first piece are searched in parallel
+float PerfectClear::Solve(const BitBoard& board, const int* queue, int queueLength, int bag, int height, const atomic<bool>& stop, Placement& best)
+{
+	nodes = 0;
+	cancel = &stop;
+	int piecesNeeded;
+	if (queueLength <= 0 || queueLength > MAX_QUEUE || height > MAX_HEIGHT || !Feasible(board, height, piecesNeeded) || piecesNeeded == 0)
+		return 0;
+
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	int count = MoveGen::Generate(board, queue[0], placements);
+	float chance[MoveGen::MAX_PLACEMENTS];
+	atomic<bool> solved(false);
+	pool.ParallelFor(count, [&](int i) {
+		// nothing beats a sure clear, the remaining branches are skipped
+		chance[i] = solved || (placements[i].tuck && !allowTucks) ? 0 : Place(board, queue[0], placements[i], queue + 1, queueLength - 1, bag, height);
+		if (chance[i] >= 1)
+			solved = true;
+	});
+
+	int bestIndex = -1;
+	for (int i = 0; i < count; i++)
+		if (chance[i] > 0 && (bestIndex < 0 || chance[i] > chance[bestIndex]))
+			bestIndex = i;
+	if (bestIndex < 0 || stop)
+		return 0;
+	best = placements[bestIndex];
+	return chance[bestIndex];
+}
+
+// placements for a queue that clears the board on its own, return how many or 0 if it can't
+int PerfectClear::Sequence(const BitBoard& board, const int* queue, int queueLength, int height, Placement* moves)
+{
+	BitBoard current = board;
+	atomic<bool> stop(false);
+	for (int i = 0; i < queueLength; i++)
+	{
+		if (Solve(current, queue + i, queueLength - i, 0, height, stop, moves[i]) < 1)
+			return 0;
+		height -= current.Place(queue[i], moves[i]);
+		if (current.IsPerfectClear())
+			return i + 1;
+	}
+	return 0;
+}
+
+long long PerfectClear::GetNodes()
+{
+	return nodes;
+}
+
+// the board can still be cleared within height rows: nothing above them, and every stretch of
+// columns between completely filled ones has a multiple of 4 empty cells
+bool PerfectClear::Feasible(const BitBoard& board, int height, int& piecesNeeded)
+{
+	int top = BitBoard::HEIGHT - 1 - height;
+	if (top < 0)
+		return false;
+	for (int y = 0; y < top; y++)
+		if (board.rows[y] & BitBoard::FIELD)
+			return false;
+
+	RowMask fullColumns = BitBoard::FIELD;
+	int empty = 0;
+	for (int y = top; y < BitBoard::HEIGHT - 1; y++)
+	{
+		fullColumns &= board.rows[y];
+		empty += PopCount(~board.rows[y] & BitBoard::FIELD);
+	}
+	if (empty % 4 != 0)
+		return false;
+	piecesNeeded = empty / 4;
+
+	RowMask open = BitBoard::FIELD & ~fullColumns;
+	while (open)
+	{
+		// lowest stretch of open columns
+		RowMask low = open & (0 - open);
+		RowMask stretch = open & ~(open + low);
+		int stretchEmpty = 0;
+		for (int y = top; y < BitBoard::HEIGHT - 1; y++)
+			stretchEmpty += PopCount(~board.rows[y] & stretch);
+		if (stretchEmpty % 4 != 0)
+			return false;
+		open &= ~stretch;
+	}
+	return true;
+}
+
+// best chance with queue[0] still to place, a missing piece is averaged over the bag
+float PerfectClear::Search(const BitBoard& board, const int* queue, int queueLength, int bag, int height)
+{
+	nodes += 1;
+	if (*cancel)
+		return 0;
+	if (queueLength == 0)
+	{
+		if (bag == 0)
+			return 0;
+		float sum = 0;
+		for (int type = 0; type < 7; type++)
+			if (bag & (1 << type))
+			{
+				int nextBag = bag & ~(1 << type);
+				sum += Search(board, &type, 1, nextBag ? nextBag : FULL_BAG, height);
+			}
+		return sum / PopCount(bag);
+	}
+
+	HashKey key = Key(board, queue, queueLength, bag, height);
+	TableEntry entry;
+	if (table.Probe(key, entry))
+		return entry.value;
+
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	int count = MoveGen::Generate(board, queue[0], placements);
+	float best = 0;
+	for (int i = 0; i < count && best < 1; i++)
+		if (!placements[i].tuck || allowTucks)
+			best = max(best, Place(board, queue[0], placements[i], queue + 1, queueLength - 1, bag, height));
+
+	entry.value = best;
+	// a stopped search may have cut branches short
+	if (!*cancel)
+		table.Store(key, entry);
+	return best;
+}
+
+// place a piece and search on with the rest of the queue
+float PerfectClear::Place(const BitBoard& board, int type, const Placement& move, const int* queue, int queueLength, int bag, int height)
+{
+	BitBoard after = board;
+	height -= after.Place(type, move);
+	if (after.IsPerfectClear())
+		return 1;
+	int piecesNeeded;
+	if (!Feasible(after, height, piecesNeeded))
+		return 0;
+	// without a bag the queue has to be long enough
+	if (bag == 0 && piecesNeeded > queueLength)
+		return 0;
+	return Search(after, queue, queueLength, bag, height);
+}
+
+HashKey PerfectClear::Key(const BitBoard& board, const int* queue, int queueLength, int bag, int height)
+{
+	HashKey key = board.hash ^ BitBoard::Mix(6ULL << 56 | (HashKey)bag << 16 | (HashKey)queueLength << 8 | (HashKey)height);
+	for (int i = 0; i < queueLength; i++)
+		key ^= BitBoard::HashQueue(i, queue[i]);
+	return key;
+}
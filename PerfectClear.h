@@ -0,0 +1,34 @@
+#pragma once
+#include <atomic>
+#include "MoveGen.h"
+#include "ThreadPool.h"
+#include "TranspositionTable.h"
+
+// finds placements that empty the board within the bottom height rows
+// pieces past the queue are drawn from bag (a mask like in Expectimax, 0 means no more pieces),
+// so the answer is the chance of a perfect clear with the best play
+class PerfectClear
+{
+public:
+	static const int FULL_BAG = 0x7F;
+	static const int MAX_HEIGHT = 6;
+	static const int MAX_QUEUE = 12;
+	static const int TABLE_SIZE_LOG2 = 20;
+	bool allowTucks = false;
+private:
+	ThreadPool& pool;
+	// results by board, queue, bag and height, kept between queries
+	TranspositionTable table;
+	atomic<long long> nodes;
+	const atomic<bool>* cancel;
+public:
+	PerfectClear(ThreadPool& threadPool);
+	float Solve(const BitBoard& board, const int* queue, int queueLength, int bag, int height, const atomic<bool>& stop, Placement& best);
+	int Sequence(const BitBoard& board, const int* queue, int queueLength, int height, Placement* moves);
+	long long GetNodes();
+	static bool Feasible(const BitBoard& board, int height, int& piecesNeeded);
+private:
+	float Search(const BitBoard& board, const int* queue, int queueLength, int bag, int height);
+	float Place(const BitBoard& board, int type, const Placement& move, const int* queue, int queueLength, int bag, int height);
+	static HashKey Key(const BitBoard& board, const int* queue, int queueLength, int bag, int height);
+};
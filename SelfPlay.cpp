@@ -0,0 +1,257 @@
+#include "SelfPlay.h"
+#include "OpeningBook.h"
+#include <chrono>
+#include <thread>
+#include <new>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(SelfPlayRecord) == 64, "the data file depends on the record layout");
+
+SelfPlay::SelfPlay(int workers)
+{
+	workerNum = workers > 0 ? workers : max(1, (int)thread::hardware_concurrency());
+	rings = nullptr;
+	ringsSize = 0;
+}
+
+SelfPlay::~SelfPlay()
+{
+	FreeRings();
+}
+
+void SelfPlay::SetPlayer(const ArenaPlayer& newPlayer)
+{
+	player = newPlayer;
+}
+
+// games are numbered from 0 and play seed + number, appended to path
+// the coordinator only writes, the games run in workerNum processes
+bool SelfPlay::Run(const string& path, int games, unsigned int seed)
+{
+	if (!AllocateRings())
+		return false;
+	FILE* file = fopen(path.c_str(), "ab");
+	if (file == nullptr)
+	{
+		FreeRings();
+		return false;
+	}
+	printf("%d games on %d workers, records in %s\n", games, workerNum, path.c_str());
+	fflush(stdout);
+
+	// fork before any thread exists, a worker that can't be forked runs on a thread
+	vector<int> pids(workerNum, -1);
+#ifndef _WIN32
+	for (int w = 0; w < workerNum; w++)
+	{
+		int pid = fork();
+		if (pid == 0)
+		{
+			Work(w, games, seed);
+			// skip exit handlers and stdio flushes of the coordinator's copies
+			_exit(0);
+		}
+		pids[w] = pid;
+	}
+#endif
+	vector<thread> threads;
+	for (int w = 0; w < workerNum; w++)
+		if (pids[w] < 0)
+			threads.push_back(thread(&SelfPlay::Work, this, w, games, seed));
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chrono::steady_clock::time_point lastProgress = start;
+	long long written = 0;
+	bool finishedAll = false;
+	while (!finishedAll)
+	{
+		finishedAll = true;
+		int batch = 0;
+		for (int w = 0; w < workerNum; w++)
+		{
+			// done is read before the ring, so a finished worker's last records are seen
+			bool finished = rings[w].done.load(memory_order_acquire) != 0;
+#ifndef _WIN32
+			// a worker that died still has its published games written, its ring is marked done for good
+			int status;
+			if (!finished && pids[w] > 0 && waitpid(pids[w], &status, WNOHANG) == pids[w])
+			{
+				pids[w] = 0;
+				finished = rings[w].done.load(memory_order_acquire) != 0;
+				if (!finished)
+				{
+					printf("\nworker %d exited before finishing its games\n", w);
+					rings[w].done.store(1, memory_order_release);
+					finished = true;
+				}
+			}
+#endif
+			batch += Drain(rings[w], file, finished);
+			if (!finished)
+				finishedAll = false;
+		}
+		written += batch;
+
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		if (finishedAll || now - lastProgress >= chrono::milliseconds(PROGRESS_MILLISECOND))
+		{
+			int played = 0;
+			for (int w = 0; w < workerNum; w++)
+				played += rings[w].games.load(memory_order_relaxed);
+			double seconds = max(1e-9, chrono::duration<double>(now - start).count());
+			printf("\r%d / %d games  %lld records  %.0f records/s   ", played, games, written, written / seconds);
+			fflush(stdout);
+			lastProgress = now;
+		}
+		if (batch == 0 && !finishedAll)
+			this_thread::sleep_for(chrono::milliseconds(IDLE_MILLISECOND));
+	}
+	printf("\n");
+	int played = 0;
+	for (int w = 0; w < workerNum; w++)
+		played += rings[w].games.load(memory_order_relaxed);
+	if (played < games)
+		printf("only %d of %d games were played\n", played, games);
+
+	for (thread& worker : threads)
+		worker.join();
+#ifndef _WIN32
+	for (int w = 0; w < workerNum; w++)
+		if (pids[w] > 0)
+			waitpid(pids[w], nullptr, 0);
+#endif
+	bool ok = !ferror(file);
+	ok = fclose(file) == 0 && ok;
+	FreeRings();
+	return ok;
+}
+
+// every placement of one game, the outcome is filled in once the game is over
+void SelfPlay::PlayGame(const ArenaPlayer& player, unsigned int seed, unsigned int game, vector<SelfPlayRecord>& records)
+{
+	records.clear();
+	HeadlessGame headless(seed);
+	vector<int> before;
+	Placement move;
+	while (!headless.gameOver && headless.pieces < MAX_PIECES && Arena::ChooseMove(player, headless, move))
+	{
+		SelfPlayRecord record;
+		for (int y = 0; y < SelfPlayRecord::ROWS; y++)
+			record.rows[y] = (unsigned short)((headless.board.rows[y] & BitBoard::FIELD) >> (BitBoard::PAD + 1));
+		record.currType = (unsigned char)headless.currType;
+		record.nextType = (unsigned char)headless.nextType;
+		record.bag = (unsigned char)headless.GetBagMask();
+		record.move = OpeningBook::PackMove(move);
+		record.game = game;
+		records.push_back(record);
+		before.push_back(headless.scores);
+		headless.Step(move);
+	}
+	for (int i = 0; i < (int)records.size(); i++)
+	{
+		records[i].toppedOut = headless.gameOver ? 1 : 0;
+		records[i].outcome = headless.scores - before[i];
+	}
+}
+
+// rings live in memory shared with the forked workers, zeroed by the system
+bool SelfPlay::AllocateRings()
+{
+	FreeRings();
+	size_t size = sizeof(SelfPlayRing) * workerNum;
+#ifdef _WIN32
+	void* memory = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (memory == NULL)
+		return false;
+#else
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+		return false;
+#endif
+	rings = (SelfPlayRing*)memory;
+	ringsSize = size;
+	for (int w = 0; w < workerNum; w++)
+	{
+		new (&rings[w]) SelfPlayRing;
+		rings[w].head.store(0);
+		rings[w].tail.store(0);
+		rings[w].games.store(0);
+		rings[w].done.store(0);
+	}
+	return true;
+}
+
+void SelfPlay::FreeRings()
+{
+	if (rings == nullptr)
+		return;
+#ifdef _WIN32
+	VirtualFree(rings, 0, MEM_RELEASE);
+#else
+	munmap(rings, ringsSize);
+#endif
+	rings = nullptr;
+	ringsSize = 0;
+}
+
+void SelfPlay::Work(int worker, int games, unsigned int seed)
+{
+	SelfPlayRing& ring = rings[worker];
+	vector<SelfPlayRecord> records;
+	records.reserve(MAX_PIECES);
+	for (int game = worker; game < games; game += workerNum)
+	{
+		PlayGame(player, seed + game, game, records);
+		Publish(ring, records);
+		ring.games.fetch_add(1, memory_order_relaxed);
+	}
+	ring.done.store(1, memory_order_release);
+}
+
+// copy records into free slots and move head once per chunk, waiting while the writer catches up
+void SelfPlay::Publish(SelfPlayRing& ring, const vector<SelfPlayRecord>& records)
+{
+	unsigned long long head = ring.head.load(memory_order_relaxed);
+	int count = (int)records.size();
+	for (int i = 0; i < count;)
+	{
+		int space = SelfPlayRing::RING_RECORDS - (int)(head - ring.tail.load(memory_order_acquire));
+		if (space == 0)
+		{
+			this_thread::sleep_for(chrono::milliseconds(IDLE_MILLISECOND));
+			continue;
+		}
+		int chunk = min(space, count - i);
+		for (int j = 0; j < chunk; j++)
+			ring.records[(head + j) % SelfPlayRing::RING_RECORDS] = records[i + j];
+		head += chunk;
+		i += chunk;
+		ring.head.store(head, memory_order_release);
+	}
+}
+
+// write what a ring holds in at most two writes, one on each side of the wrap, and return how many records
+int SelfPlay::Drain(SelfPlayRing& ring, FILE* file, bool finished)
+{
+	unsigned long long head = ring.head.load(memory_order_acquire);
+	unsigned long long tail = ring.tail.load(memory_order_relaxed);
+	int available = (int)(head - tail);
+	if (available == 0 || (available < WRITE_BATCH && !finished))
+		return 0;
+	int start = (int)(tail % SelfPlayRing::RING_RECORDS);
+	int first = min(available, SelfPlayRing::RING_RECORDS - start);
+	fwrite(&ring.records[start], sizeof(SelfPlayRecord), first, file);
+	if (available > first)
+		fwrite(&ring.records[0], sizeof(SelfPlayRecord), available - first, file);
+	ring.tail.store(head, memory_order_release);
+	return available;
+}
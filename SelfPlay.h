@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdio>
+#include "Arena.h"
+
+using namespace std;
+
+// one placement of a self-play game as stored in the data file, 64 bytes
+struct SelfPlayRecord
+{
+	static const int ROWS = BitBoard::HEIGHT - 1;
+	// playfield columns 1 .. 10 as bits 0 .. 9, top row first
+	unsigned short rows[ROWS];
+	unsigned char currType;
+	unsigned char nextType;
+	// mask of pieces that can still come after next, see Expectimax
+	unsigned char bag;
+	// 1 if the game ended by topping out, 0 if it reached the piece limit
+	unsigned char toppedOut;
+	// packed like OpeningBook::PackMove
+	unsigned short move;
+	// points scored from this placement to the end of the game
+	int outcome;
+	unsigned int game;
+};
+
+// single producer single consumer ring in shared memory, the worker fills records and the writer drains them
+// both counters only grow, a slot is record index % RING_RECORDS
+struct SelfPlayRing
+{
+	static const int RING_RECORDS = 1 << 14;
+	// records published by the worker
+	alignas(64) atomic<unsigned long long> head;
+	// records written to disk by the writer
+	alignas(64) atomic<unsigned long long> tail;
+	alignas(64) atomic<int> games;
+	atomic<int> done;
+	alignas(64) SelfPlayRecord records[RING_RECORDS];
+};
+
+// plays headless games in worker processes forked from here and streams every placement to a data file
+// each worker publishes a whole game to its own ring at once, the writer copies rings to the file in large writes
+// without fork (_WIN32, or if fork fails) the workers are threads sharing the same rings
+class SelfPlay
+{
+public:
+	static const int MAX_PIECES = 2000;
+	// the writer waits for this many records of a ring before writing them, unless its worker is done
+	static const int WRITE_BATCH = 4096;
+	static const int IDLE_MILLISECOND = 1;
+	static const int PROGRESS_MILLISECOND = 1000;
+private:
+	ArenaPlayer player;
+	int workerNum;
+	SelfPlayRing* rings;
+	size_t ringsSize;
+public:
+	SelfPlay(int workers = 0);
+	~SelfPlay();
+	void SetPlayer(const ArenaPlayer& newPlayer);
+	bool Run(const string& path, int games, unsigned int seed = 1);
+	static void PlayGame(const ArenaPlayer& player, unsigned int seed, unsigned int game, vector<SelfPlayRecord>& records);
+private:
+	bool AllocateRings();
+	void FreeRings();
+	void Work(int worker, int games, unsigned int seed);
+	static void Publish(SelfPlayRing& ring, const vector<SelfPlayRecord>& records);
+	static int Drain(SelfPlayRing& ring, FILE* file, bool finished);
+};
@@ -0,0 +1,139 @@
+#include "SurfaceFit.h"
+
+Surface::Surface()
+{
+	for (int x = 0; x < COLUMNS; x++)
+	{
+		height[x] = 0;
+		window[x] = 0;
+	}
+}
+
+Surface::Surface(const BitBoard& board)
+{
+	FromBoard(board);
+}
+
+// the first filled cell from the top of every column, holes under it don't matter
+void Surface::FromBoard(const BitBoard& board)
+{
+	for (int x = 0; x < COLUMNS; x++)
+		height[x] = 0;
+	RowMask covered = 0;
+	for (int y = 0; y < BitBoard::HEIGHT - 1 && covered != BitBoard::FIELD; y++)
+	{
+		RowMask found = board.rows[y] & BitBoard::FIELD & ~covered;
+		covered |= found;
+		for (; found; found &= found - 1)
+			height[LowestBit(found) - BitBoard::PAD - 1] = BitBoard::HEIGHT - 1 - y;
+	}
+
+	int step[COLUMNS + 2];
+	for (int x = 0; x < COLUMNS + 2; x++)
+		step[x] = x < COLUMNS - 1 ? max(-MAX_STEP, min(MAX_STEP, height[x + 1] - height[x])) + MAX_STEP : 2 * MAX_STEP;
+	for (int x = 0; x < COLUMNS; x++)
+		window[x] = step[x] + STEPS * step[x + 1] + STEPS * STEPS * step[x + 2];
+}
+
+struct FitTables
+{
+	// bit rot is set if the piece in rot fits cleanly with its leftmost column on the first column of the window
+	unsigned char fit[7][Surface::WINDOWS];
+	// first columns where each rotation stays inside the walls
+	RowMask inside[7][4];
+	// leftmost filled column of the piece box
+	int left[7][4];
+	FitTables();
+};
+
+// a rotation fits a window when every step of the surface equals the step of the piece bottom, so all its columns land at once
+FitTables::FitTables()
+{
+	for (int type = 0; type < 7; type++)
+	{
+		for (int w = 0; w < Surface::WINDOWS; w++)
+			fit[type][w] = 0;
+		for (int rot = 0; rot < 4; rot++)
+		{
+			const RowMask* rows = BitBoard::PieceRows(type, rot);
+			// height of the lowest cell of each box column, -1 for an empty column
+			int bottom[4] = { -1, -1, -1, -1 };
+			for (int y = 0; y < 4; y++)
+				for (int c = 0; c < 4; c++)
+					if (rows[y] & (1u << c))
+						bottom[c] = 3 - y;
+			left[type][rot] = 0;
+			while (bottom[left[type][rot]] < 0)
+				left[type][rot] += 1;
+			int width = 0;
+			while (left[type][rot] + width < 4 && bottom[left[type][rot] + width] >= 0)
+				width += 1;
+
+			inside[type][rot] = 0;
+			for (int x = 0; x + width <= Surface::COLUMNS; x++)
+				inside[type][rot] |= 1u << x;
+
+			for (int w = 0; w < Surface::WINDOWS; w++)
+			{
+				bool flush = true;
+				int rest = w;
+				for (int c = 0; c < 3; c++, rest /= Surface::STEPS)
+					if (c < width - 1)
+					{
+						int step = rest % Surface::STEPS - Surface::MAX_STEP;
+						int need = bottom[left[type][rot] + c + 1] - bottom[left[type][rot] + c];
+						if (step != need)
+							flush = false;
+					}
+				if (flush)
+					fit[type][w] |= 1 << rot;
+			}
+		}
+	}
+}
+
+// built on first use, the piece tables need Game::PIECE
+static const FitTables& Tables()
+{
+	static FitTables tables;
+	return tables;
+}
+
+// x of every clean placement of each rotation, as bits x + PAD like the masks of MoveGen
+void SurfaceFit::CleanFits(const Surface& surface, int type, RowMask* fits)
+{
+	const FitTables& tables = Tables();
+	RowMask columns[4] = { 0, 0, 0, 0 };
+	for (int x = 0; x < Surface::COLUMNS; x++)
+	{
+		int rotations = tables.fit[type][surface.window[x]];
+		for (int rot = 0; rot < 4; rot++)
+			if (rotations & (1 << rot))
+				columns[rot] |= 1u << x;
+	}
+	// surface column x is gameboard column x + 1, the piece box starts left of its first filled column
+	for (int rot = 0; rot < 4; rot++)
+	{
+		RowMask bits = columns[rot] & tables.inside[type][rot];
+		int shift = 1 - tables.left[type][rot] + BitBoard::PAD;
+		fits[rot] = bits << shift;
+	}
+}
+
+// keep the hard drops that fit cleanly, in order, and return how many
+// tucks land under the surface, so they are dropped too; a board with no clean fit keeps every placement
+int SurfaceFit::FilterClean(const BitBoard& board, int type, Placement* placements, int count)
+{
+	RowMask fits[4];
+	CleanFits(Surface(board), type, fits);
+	int kept = 0;
+	for (int i = 0; i < count; i++)
+		if (!placements[i].tuck && (fits[placements[i].rotation] >> (placements[i].x + BitBoard::PAD) & 1))
+			placements[kept++] = placements[i];
+	return kept > 0 ? kept : count;
+}
+
+void SurfaceFit::InitTables()
+{
+	Tables();
+}
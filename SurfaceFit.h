@@ -0,0 +1,29 @@
+#pragma once
+#include "BitBoard.h"
+
+// the top of the stack as column heights and the steps between neighbouring columns
+struct Surface
+{
+	static const int COLUMNS = BitBoard::WIDTH - 2;
+	// steps are clamped to -MAX_STEP .. MAX_STEP, one more than any piece bottom has
+	static const int MAX_STEP = 3;
+	static const int STEPS = 2 * MAX_STEP + 1;
+	// window of three steps, enough for the four columns of the widest piece
+	static const int WINDOWS = STEPS * STEPS * STEPS;
+	int height[COLUMNS];
+	// index of the steps right of each column, steps past the wall count as MAX_STEP
+	int window[COLUMNS];
+	Surface();
+	Surface(const BitBoard& board);
+	void FromBoard(const BitBoard& board);
+};
+
+// placements that land flush on the surface, so a hard drop leaves no hole under the piece
+// a table by piece and window of steps gives the rotations that fit, one lookup per column
+class SurfaceFit
+{
+public:
+	static void CleanFits(const Surface& surface, int type, RowMask* fits);
+	static int FilterClean(const BitBoard& board, int type, Placement* placements, int count);
+	static void InitTables();
+};
@@ -0,0 +1,191 @@
+#include "TerminalRenderer.h"
+#include "Game.h"
+#include <cstdio>
+#ifdef _WIN32
+#include <conio.h>
+#else
+#include <termios.h>
+#include <unistd.h>
+
+// console mode before EnableInput, there is only one console
+static termios savedMode;
+#endif
+
+// pack a color into 0xRRGGBB, empty cells are stored as black
+static unsigned int PackColor(const Color& color)
+{
+	return (color.r & 255) << 16 | (color.g & 255) << 8 | (color.b & 255);
+}
+
+TerminalRenderer::TerminalRenderer()
+{
+	width = 0;
+	height = 0;
+	inputEnabled = false;
+	frame.reserve(16 * 1024);
+	Reset();
+}
+
+TerminalRenderer::~TerminalRenderer()
+{
+	DisableInput();
+	// restore the cursor and the default colors
+	if (!firstFrame)
+	{
+		frame = "\x1b[0m\x1b[?25h";
+		MoveCursor(0, height + 1);
+		frame += "\n";
+		Flush();
+	}
+}
+
+// force a full redraw on the next frame
+void TerminalRenderer::Reset()
+{
+	firstFrame = true;
+	prevCells.clear();
+	prevColors.clear();
+	prevStatus.clear();
+	cursorX = -1;
+	cursorY = -1;
+	currColor = 0xFFFFFFFF;
+}
+
+void TerminalRenderer::Draw(const char* cells, const Color* colors, int boardWidth, int boardHeight, int firstRow, const string& status)
+{
+	if (boardWidth != width || boardHeight - firstRow != height)
+	{
+		width = boardWidth;
+		height = boardHeight - firstRow;
+		Reset();
+	}
+
+	frame.clear();
+	if (firstFrame)
+	{
+		// clear screen and hide cursor
+		frame += "\x1b[0m\x1b[2J\x1b[?25l";
+		prevCells.assign(width * height, '\0');
+		prevColors.assign(width * height, 0xFFFFFFFF);
+		firstFrame = false;
+	}
+
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+		{
+			int i = y * width + x;
+			int j = (y + firstRow) * boardWidth + x;
+			char cell = (cells[j] == 'x' || cells[j] == 'o') ? cells[j] : '.';
+			unsigned int color = cell == '.' ? 0 : PackColor(colors[j]);
+			if (prevCells[i] == cell && prevColors[i] == color)
+				continue;
+
+			prevCells[i] = cell;
+			prevColors[i] = color;
+			MoveCursor(x * CELL_WIDTH, y);
+			SetColor(color);
+			frame += cell == '.' ? " ." : "  ";
+			cursorX += CELL_WIDTH;
+		}
+
+	if (status != prevStatus)
+	{
+		prevStatus = status;
+		MoveCursor(0, height);
+		frame += "\x1b[0m\x1b[2K";
+		currColor = 0xFFFFFFFF;
+		frame += status;
+		cursorX += (int)status.size();
+	}
+
+	if (!frame.empty())
+		Flush();
+}
+
+// cursor position is tracked so consecutive changed cells need no escape code
+void TerminalRenderer::MoveCursor(int x, int y)
+{
+	if (x == cursorX && y == cursorY)
+		return;
+	frame += "\x1b[" + to_string(y + 1) + ";" + to_string(x + 1) + "H";
+	cursorX = x;
+	cursorY = y;
+}
+
+void TerminalRenderer::SetColor(unsigned int color)
+{
+	if (color == currColor)
+		return;
+	frame += "\x1b[48;2;" + to_string(color >> 16 & 255) + ";" + to_string(color >> 8 & 255) + ";" + to_string(color & 255) + "m";
+	currColor = color;
+}
+
+// write the whole frame with a single call
+void TerminalRenderer::Flush()
+{
+	fwrite(frame.data(), 1, frame.size(), stdout);
+	fflush(stdout);
+}
+
+// read keys as they are pressed, without echo or waiting for enter, false if stdin isn't a console
+bool TerminalRenderer::EnableInput()
+{
+	if (inputEnabled)
+		return true;
+#ifndef _WIN32
+	if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &savedMode) < 0)
+		return false;
+	termios mode = savedMode;
+	mode.c_lflag &= ~(ICANON | ECHO);
+	// reads return at once, with nothing when no key is waiting
+	mode.c_cc[VMIN] = 0;
+	mode.c_cc[VTIME] = 0;
+	if (tcsetattr(STDIN_FILENO, TCSANOW, &mode) < 0)
+		return false;
+#endif
+	inputEnabled = true;
+	return true;
+}
+
+void TerminalRenderer::DisableInput()
+{
+	if (!inputEnabled)
+		return;
+#ifndef _WIN32
+	tcsetattr(STDIN_FILENO, TCSANOW, &savedMode);
+#endif
+	inputEnabled = false;
+}
+
+// the next key pressed, KEY_NONE if there is none waiting or it means nothing
+int TerminalRenderer::ReadKey()
+{
+	if (!inputEnabled)
+		return KEY_NONE;
+#ifdef _WIN32
+	if (!_kbhit())
+		return KEY_NONE;
+	int c = _getch();
+	// arrows come as 0 or 224 and then a scan code
+	if (c == 0 || c == 224)
+	{
+		c = _getch();
+		return c == 75 ? KEY_LEFT : c == 77 ? KEY_RIGHT : c == 72 ? KEY_UP : c == 80 ? KEY_DOWN : KEY_NONE;
+	}
+#else
+	unsigned char key;
+	if (read(STDIN_FILENO, &key, 1) != 1)
+		return KEY_NONE;
+	int c = key;
+	// arrows come as escape [ A .. D, sent together so the rest is already waiting
+	if (c == 27)
+	{
+		unsigned char sequence[2];
+		if (read(STDIN_FILENO, &sequence[0], 1) != 1 || sequence[0] != '[' || read(STDIN_FILENO, &sequence[1], 1) != 1)
+			return KEY_NONE;
+		c = sequence[1];
+		return c == 'D' ? KEY_LEFT : c == 'C' ? KEY_RIGHT : c == 'A' ? KEY_UP : c == 'B' ? KEY_DOWN : KEY_NONE;
+	}
+#endif
+	return c == ' ' ? KEY_DROP : c == 'a' || c == 'A' ? KEY_AUTOPLAY : c == 'q' || c == 'Q' ? KEY_QUIT : KEY_NONE;
+}
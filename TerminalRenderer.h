@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <string>
+
+using namespace std;
+
+struct Color;
+
+// draw the gameboard into an ANSI terminal, only the cells changed since the last frame are written
+// with input enabled the console is read a key at a time without echo, so a game can be played over ssh
+class TerminalRenderer
+{
+public:
+	static const int CELL_WIDTH = 2;
+	// keys returned by ReadKey, arrows and space as in the window, a toggles autoplay and q quits
+	static const int KEY_NONE = 0;
+	static const int KEY_LEFT = 1;
+	static const int KEY_RIGHT = 2;
+	static const int KEY_UP = 3;
+	static const int KEY_DOWN = 4;
+	static const int KEY_DROP = 5;
+	static const int KEY_AUTOPLAY = 6;
+	static const int KEY_QUIT = 7;
+private:
+	bool inputEnabled;
+	int width;
+	int height;
+	bool firstFrame;
+	vector<char> prevCells;
+	vector<unsigned int> prevColors;
+	string prevStatus;
+	string frame;
+	int cursorX;
+	int cursorY;
+	unsigned int currColor;
+public:
+	TerminalRenderer();
+	~TerminalRenderer();
+	void Reset();
+	void Draw(const char* cells, const Color* colors, int boardWidth, int boardHeight, int firstRow, const string& status);
+	bool EnableInput();
+	void DisableInput();
+	int ReadKey();
+private:
+	void MoveCursor(int x, int y);
+	void SetColor(unsigned int color);
+	void Flush();
+};
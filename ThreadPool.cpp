@@ -0,0 +1,103 @@
+#include "ThreadPool.h"
+
+// threadNum 0 uses every hardware thread
+ThreadPool::ThreadPool(int threadNum)
+{
+	if (threadNum <= 0)
+		threadNum = max(1, (int)thread::hardware_concurrency());
+	quit = false;
+	queued = 0;
+	nextQueue = 0;
+	for (int i = 0; i < threadNum; i++)
+		queues.push_back(unique_ptr<TaskQueue>(new TaskQueue()));
+	for (int i = 0; i < threadNum; i++)
+		workers.push_back(thread(&ThreadPool::Work, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> guard(sleepLock);
+		quit = true;
+	}
+	wake.notify_all();
+	for (thread& worker : workers)
+		worker.join();
+}
+
+int ThreadPool::Size()
+{
+	return (int)workers.size();
+}
+
+void ThreadPool::Submit(function<void()> task)
+{
+	TaskQueue& queue = *queues[nextQueue++ % queues.size()];
+	{
+		lock_guard<mutex> guard(queue.lock);
+		queue.tasks.push_back(move(task));
+	}
+	queued += 1;
+	// the empty critical section orders the notify after a worker's check of queued
+	{
+		lock_guard<mutex> guard(sleepLock);
+	}
+	wake.notify_one();
+}
+
+// run body(0) .. body(n - 1) on the pool, the calling thread helps until every index is done
+void ThreadPool::ParallelFor(int n, const function<void(int)>& body)
+{
+	atomic<int> remaining(n);
+	for (int i = 0; i < n; i++)
+		Submit([&body, &remaining, i] {
+			body(i);
+			remaining -= 1;
+		});
+	while (remaining > 0)
+		if (!RunOne(-1))
+			this_thread::yield();
+}
+
+void ThreadPool::Work(int id)
+{
+	while (!quit)
+	{
+		if (RunOne(id))
+			continue;
+		unique_lock<mutex> guard(sleepLock);
+		wake.wait(guard, [this] { return quit || queued > 0; });
+	}
+}
+
+// run one task from our own queue or stolen from another, id -1 only steals
+bool ThreadPool::RunOne(int id)
+{
+	function<void()> task;
+	int size = (int)queues.size();
+	if (id >= 0)
+	{
+		TaskQueue& own = *queues[id];
+		lock_guard<mutex> guard(own.lock);
+		if (!own.tasks.empty())
+		{
+			task = move(own.tasks.back());
+			own.tasks.pop_back();
+		}
+	}
+	for (int k = 1; k <= size && !task; k++)
+	{
+		TaskQueue& other = *queues[(id + size + k) % size];
+		lock_guard<mutex> guard(other.lock);
+		if (!other.tasks.empty())
+		{
+			task = move(other.tasks.front());
+			other.tasks.pop_front();
+		}
+	}
+	if (!task)
+		return false;
+	queued -= 1;
+	task();
+	return true;
+}
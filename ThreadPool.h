@@ -0,0 +1,38 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+
+using namespace std;
+
+// work-stealing thread pool, each worker pops its own queue from the back and steals from the front of the others
+class ThreadPool
+{
+private:
+	struct TaskQueue
+	{
+		mutex lock;
+		deque<function<void()>> tasks;
+	};
+	vector<thread> workers;
+	vector<unique_ptr<TaskQueue>> queues;
+	atomic<bool> quit;
+	atomic<int> queued;
+	atomic<unsigned int> nextQueue;
+	mutex sleepLock;
+	condition_variable wake;
+public:
+	ThreadPool(int threadNum = 0);
+	~ThreadPool();
+	int Size();
+	void Submit(function<void()> task);
+	void ParallelFor(int n, const function<void(int)>& body);
+private:
+	void Work(int id);
+	bool RunOne(int id);
+};
@@ -0,0 +1,67 @@
+#include "TranspositionTable.h"
+#include <cstring>
+
+TranspositionTable::TranspositionTable(int sizeLog2)
+{
+	mask = (1ULL << sizeLog2) - 1;
+	slots.reset(new Slot[(size_t)mask + 1]);
+	Clear();
+}
+
+bool TranspositionTable::Probe(HashKey key, TableEntry& entry) const
+{
+	const Slot& slot = slots[key & mask];
+	HashKey data = slot.data.load(memory_order_relaxed);
+	HashKey check = slot.check.load(memory_order_relaxed);
+	// an empty slot has data 0, so its check only matches key 0
+	if ((check ^ data) != key || data == 0)
+		return false;
+	entry = Unpack(data);
+	return true;
+}
+
+// replace the slot unless it holds a deeper result for the same key
+void TranspositionTable::Store(HashKey key, const TableEntry& entry)
+{
+	Slot& slot = slots[key & mask];
+	HashKey oldData = slot.data.load(memory_order_relaxed);
+	HashKey oldCheck = slot.check.load(memory_order_relaxed);
+	if ((oldCheck ^ oldData) == key && oldData != 0 && Unpack(oldData).depth > entry.depth)
+		return;
+	HashKey data = Pack(entry);
+	slot.data.store(data, memory_order_relaxed);
+	slot.check.store(key ^ data, memory_order_relaxed);
+}
+
+// not safe while other threads use the table
+void TranspositionTable::Clear()
+{
+	for (HashKey i = 0; i <= mask; i++)
+	{
+		slots[i].check.store(0, memory_order_relaxed);
+		slots[i].data.store(0, memory_order_relaxed);
+	}
+}
+
+int TranspositionTable::Size() const
+{
+	return (int)(mask + 1);
+}
+
+// value in bits 0-31, depth in 32-46, bit 47 marks the slot as used, move in 48-63
+HashKey TranspositionTable::Pack(const TableEntry& entry)
+{
+	unsigned int value;
+	memcpy(&value, &entry.value, sizeof(value));
+	return (HashKey)value | (HashKey)(entry.depth & 0x7FFF) << 32 | (HashKey)(entry.move & 0xFFFF) << 48 | 1ULL << 47;
+}
+
+TableEntry TranspositionTable::Unpack(HashKey data)
+{
+	TableEntry entry;
+	unsigned int value = (unsigned int)data;
+	memcpy(&entry.value, &value, sizeof(value));
+	entry.depth = (int)(data >> 32 & 0x7FFF);
+	entry.move = (int)(data >> 48 & 0xFFFF);
+	return entry;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include "BitBoard.h"
+
+using namespace std;
+
+struct TableEntry
+{
+	float value = 0;
+	// how much search is behind value, deeper entries are kept over shallower ones
+	int depth = 0;
+	// free for the caller, e.g. the index of the best placement
+	int move = 0;
+};
+
+// fixed-size hash table shared by the search threads without locks
+// every slot stores key ^ data next to data, a slot torn by two writers fails the check and reads as a miss
+class TranspositionTable
+{
+public:
+	static const int DEFAULT_SIZE_LOG2 = 18;
+private:
+	struct Slot
+	{
+		atomic<HashKey> check;
+		atomic<HashKey> data;
+	};
+	unique_ptr<Slot[]> slots;
+	HashKey mask;
+public:
+	TranspositionTable(int sizeLog2 = DEFAULT_SIZE_LOG2);
+	bool Probe(HashKey key, TableEntry& entry) const;
+	void Store(HashKey key, const TableEntry& entry);
+	void Clear();
+	int Size() const;
+private:
+	static HashKey Pack(const TableEntry& entry);
+	static TableEntry Unpack(HashKey data);
+};
@@ -0,0 +1,257 @@
+#include "Tuner.h"
+#include "MoveGen.h"
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+const float Tuner::START_SIGMA = 0.5f;
+const float Tuner::MIN_SIGMA = 0.05f;
+const float Tuner::SIGMA_DECAY = 0.97f;
+
+// the first generation is the default weights and mutations of them
+Tuner::Tuner(unsigned int seed)
+{
+	baseSeed = seed;
+	generation = 0;
+	sigma = START_SIGMA;
+	EvalWeights defaults;
+	norm = 0;
+	for (int i = 0; i < BoardFeatures::NUM; i++)
+		norm += defaults.weight[i] * defaults.weight[i];
+	norm = sqrt(norm);
+
+	mt19937 random(seed);
+	normal_distribution<float> noise(0, 1);
+	population.resize(POPULATION);
+	for (int c = 0; c < POPULATION; c++)
+	{
+		population[c].weights = defaults;
+		if (c > 0)
+			for (int i = 0; i < BoardFeatures::NUM; i++)
+				population[c].weights.weight[i] += noise(random) * sigma * norm / sqrt((float)BoardFeatures::NUM);
+		Normalize(population[c].weights);
+		population[c].fitness = 0;
+	}
+}
+
+// run generations (0 for no end), resuming from the checkpoint if there is one and saving it after every generation
+void Tuner::Run(const string& checkpointPath, int generations)
+{
+	if (!checkpointPath.empty() && LoadCheckpoint(checkpointPath))
+		cout << "Resumed " << checkpointPath << " at generation " << generation << endl;
+	cout << "Tuning on " << pool.Size() << " threads, " << POPULATION << " candidates x " << GAMES << " games" << endl;
+
+	for (int g = 0; generations == 0 || g < generations; g++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		long long pieces = Evaluate();
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		float mean = 0;
+		for (const Candidate& candidate : population)
+			mean += candidate.fitness;
+		mean /= POPULATION;
+		const Candidate& best = population[0];
+		printf("generation %d  best %.1f  mean %.1f lines/game  sigma %.3f  %.1f games/s  %.0f pieces/s\n",
+			generation, best.fitness, mean, sigma, POPULATION * GAMES / seconds, pieces / seconds);
+		for (int i = 0; i < BoardFeatures::NUM; i++)
+			printf("  %-20s %9.4f\n", BoardFeatures::NAME[i], best.weights.weight[i]);
+		fflush(stdout);
+
+		Breed();
+		if (!checkpointPath.empty() && !SaveCheckpoint(checkpointPath))
+			cout << "Failed to save " << checkpointPath << endl;
+	}
+}
+
+// fittest weights of the last generation played
+const EvalWeights& Tuner::GetBest() const
+{
+	return population[0].weights;
+}
+
+// greedy play by static score until the game is lost or maxPieces, return the lines cleared
+int Tuner::PlayGame(const EvalWeights& weights, unsigned int seed, int maxPieces, int& pieces)
+{
+	HeadlessGame game(seed);
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	BitBoard boards[MoveGen::MAX_PLACEMENTS];
+	const BitBoard* boardPtr[MoveGen::MAX_PLACEMENTS];
+	int lines[MoveGen::MAX_PLACEMENTS];
+	float scores[MoveGen::MAX_PLACEMENTS];
+	while (!game.gameOver && game.pieces < maxPieces)
+	{
+		int count = MoveGen::Generate(game.board, game.currType, placements);
+		if (count == 0)
+			break;
+		for (int i = 0; i < count; i++)
+		{
+			boards[i] = game.board;
+			lines[i] = boards[i].Place(game.currType, placements[i]);
+			boardPtr[i] = &boards[i];
+		}
+		Evaluator::ScoreBatch(boardPtr, lines, count, weights, scores);
+		int best = 0;
+		for (int i = 1; i < count; i++)
+			if (scores[i] > scores[best])
+				best = i;
+		game.Step(placements[best]);
+	}
+	pieces = game.pieces;
+	return game.clearLinesNum;
+}
+
+// every game of every candidate is its own task so the cores stay busy to the end, return the pieces played
+// the population is left sorted by fitness, best first
+long long Tuner::Evaluate()
+{
+	vector<int> lines(POPULATION * GAMES);
+	vector<int> pieces(POPULATION * GAMES);
+	pool.ParallelFor(POPULATION * GAMES, [&](int task) {
+		lines[task] = PlayGame(population[task / GAMES].weights, Seed(task % GAMES), MAX_PIECES, pieces[task]);
+	});
+
+	long long total = 0;
+	for (int c = 0; c < POPULATION; c++)
+	{
+		long long sum = 0;
+		for (int g = 0; g < GAMES; g++)
+		{
+			sum += lines[c * GAMES + g];
+			total += pieces[c * GAMES + g];
+		}
+		population[c].fitness = (float)sum / GAMES;
+	}
+	stable_sort(population.begin(), population.end(), [](const Candidate& a, const Candidate& b) { return a.fitness > b.fitness; });
+	return total;
+}
+
+// keep the elite, fill the rest with uniform crossover of tournament winners plus gaussian noise
+// the random numbers depend only on the seed and generation, so a resumed run breeds the same children
+void Tuner::Breed()
+{
+	mt19937 random((unsigned int)BitBoard::Mix((HashKey)baseSeed << 32 | (unsigned int)generation));
+	normal_distribution<float> noise(0, 1);
+	uniform_int_distribution<int> pick(0, POPULATION - 1);
+	auto Tournament = [&]() {
+		int winner = pick(random);
+		for (int i = 1; i < TOURNAMENT; i++)
+			winner = min(winner, pick(random));
+		return winner;
+	};
+
+	vector<Candidate> next(population.begin(), population.begin() + ELITE);
+	float step = sigma * norm / sqrt((float)BoardFeatures::NUM);
+	while ((int)next.size() < POPULATION)
+	{
+		const EvalWeights& a = population[Tournament()].weights;
+		const EvalWeights& b = population[Tournament()].weights;
+		Candidate child;
+		for (int i = 0; i < BoardFeatures::NUM; i++)
+			child.weights.weight[i] = (random() & 1 ? a : b).weight[i] + noise(random) * step;
+		Normalize(child.weights);
+		child.fitness = 0;
+		next.push_back(child);
+	}
+	population = next;
+	generation += 1;
+	sigma = max(MIN_SIGMA, sigma * SIGMA_DECAY);
+}
+
+void Tuner::Normalize(EvalWeights& weights) const
+{
+	float length = 0;
+	for (int i = 0; i < BoardFeatures::NUM; i++)
+		length += weights.weight[i] * weights.weight[i];
+	length = sqrt(length);
+	if (length > 0)
+		for (int i = 0; i < BoardFeatures::NUM; i++)
+			weights.weight[i] *= norm / length;
+}
+
+// the seeds of a generation, new every generation so the weights can't learn one set of games
+unsigned int Tuner::Seed(int index) const
+{
+	return (unsigned int)BitBoard::Mix((HashKey)baseSeed << 40 ^ (HashKey)generation << 16 ^ (unsigned int)index);
+}
+
+// text file: generation, seed and sigma, then one candidate per line as fitness and weights
+bool Tuner::LoadCheckpoint(const string& path)
+{
+	FILE* file = fopen(path.c_str(), "r");
+	if (file == nullptr)
+		return false;
+	int loadedGeneration;
+	unsigned int loadedSeed;
+	float loadedSigma;
+	bool ok = fscanf(file, "generation %d seed %u sigma %f", &loadedGeneration, &loadedSeed, &loadedSigma) == 3;
+	vector<Candidate> loaded(POPULATION);
+	for (int c = 0; c < POPULATION && ok; c++)
+	{
+		ok = fscanf(file, "%f", &loaded[c].fitness) == 1;
+		for (int i = 0; i < BoardFeatures::NUM && ok; i++)
+			ok = fscanf(file, "%f", &loaded[c].weights.weight[i]) == 1;
+	}
+	fclose(file);
+	if (!ok)
+		return false;
+	generation = loadedGeneration;
+	baseSeed = loadedSeed;
+	sigma = loadedSigma;
+	population = loaded;
+	return true;
+}
+
+// best weights of a checkpoint, the elite is saved first and in order
+bool Tuner::LoadBest(const string& path, EvalWeights& weights)
+{
+	FILE* file = fopen(path.c_str(), "r");
+	if (file == nullptr)
+		return false;
+	int generation;
+	unsigned int seed;
+	float sigma, fitness;
+	bool ok = fscanf(file, "generation %d seed %u sigma %f %f", &generation, &seed, &sigma, &fitness) == 4;
+	for (int i = 0; i < BoardFeatures::NUM && ok; i++)
+		ok = fscanf(file, "%f", &weights.weight[i]) == 1;
+	fclose(file);
+	return ok;
+}
+
+// temp takes the place of path in one step, so there is no moment without a file at path
+static bool ReplaceFile(const string& temp, const string& path)
+{
+#ifdef _WIN32
+	// rename doesn't replace an existing file on Windows
+	return MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(temp.c_str(), path.c_str()) == 0;
+#endif
+}
+
+// written next to the old checkpoint first, so a run killed while saving still has a whole file
+bool Tuner::SaveCheckpoint(const string& path) const
+{
+	string temp = path + ".tmp";
+	FILE* file = fopen(temp.c_str(), "w");
+	if (file == nullptr)
+		return false;
+	fprintf(file, "generation %d seed %u sigma %.9g\n", generation, baseSeed, sigma);
+	for (const Candidate& candidate : population)
+	{
+		fprintf(file, "%.9g", candidate.fitness);
+		for (int i = 0; i < BoardFeatures::NUM; i++)
+			fprintf(file, " %.9g", candidate.weights.weight[i]);
+		fprintf(file, "\n");
+	}
+	if (fclose(file) != 0)
+		return false;
+	return ReplaceFile(temp, path);
+}
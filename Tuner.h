@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <random>
+#include "Evaluator.h"
+#include "HeadlessGame.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// evolves EvalWeights with a genetic algorithm, the games of a generation are played on every core
+// all candidates of a generation play the same seeds, so the pieces never decide which weights win
+class Tuner
+{
+public:
+	static const int POPULATION = 48;
+	static const int GAMES = 12;
+	// a game ends here, good weights would otherwise play forever
+	static const int MAX_PIECES = 5000;
+	// best candidates carried into the next generation unchanged
+	static const int ELITE = 6;
+	// candidates picked at random for each parent, the fittest of them wins
+	static const int TOURNAMENT = 3;
+	static const float START_SIGMA;
+	static const float MIN_SIGMA;
+	static const float SIGMA_DECAY;
+private:
+	struct Candidate
+	{
+		EvalWeights weights;
+		// lines cleared per game
+		float fitness;
+	};
+	ThreadPool pool;
+	vector<Candidate> population;
+	unsigned int baseSeed;
+	int generation;
+	float sigma;
+	// length of the default weights, every candidate is scaled to it since only their direction matters
+	float norm;
+public:
+	Tuner(unsigned int seed = 1);
+	void Run(const string& checkpointPath, int generations = 0);
+	const EvalWeights& GetBest() const;
+	static int PlayGame(const EvalWeights& weights, unsigned int seed, int maxPieces, int& pieces);
+	static bool LoadBest(const string& path, EvalWeights& weights);
+private:
+	long long Evaluate();
+	void Breed();
+	void Normalize(EvalWeights& weights) const;
+	unsigned int Seed(int index) const;
+	bool LoadCheckpoint(const string& path);
+	bool SaveCheckpoint(const string& path) const;
+};
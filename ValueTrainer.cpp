@@ -0,0 +1,458 @@
+#include "ValueTrainer.h"
+#include "Evaluator.h"
+#include "MoveGen.h"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TRAINER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+const float ValueTrainer::GAMMA = 0.99f;
+const float ValueTrainer::LEARNING_RATE = 0.0003f;
+const float ValueTrainer::EPSILON_START = 0.1f;
+const float ValueTrainer::EPSILON_END = 0.01f;
+
+// Adam
+static const float BETA1 = 0.9f;
+static const float BETA2 = 0.999f;
+static const float ADAM_EPSILON = 1e-8f;
+
+#ifdef TRAINER_X86
+AVX2_TARGET static void AxpyAvx2(float a, const float* x, float* y, int n)
+{
+	__m256 scale = _mm256_set1_ps(a);
+	for (int i = 0; i < n; i += 8)
+		_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(scale, _mm256_loadu_ps(x + i))));
+}
+
+AVX2_TARGET static float DotAvx2(const float* a, const float* b, int n)
+{
+	__m256 sum = _mm256_setzero_ps();
+	for (int i = 0; i < n; i += 8)
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+	__m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+	half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+	half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+	return _mm_cvtss_f32(half);
+}
+#endif
+
+// y += a * x, n is a multiple of 8
+static void Axpy(float a, const float* x, float* y, int n)
+{
+#ifdef TRAINER_X86
+	static const bool avx2 = Evaluator::HasAvx2();
+	if (avx2)
+	{
+		AxpyAvx2(a, x, y, n);
+		return;
+	}
+#endif
+	for (int i = 0; i < n; i++)
+		y[i] += a * x[i];
+}
+
+static float Dot(const float* a, const float* b, int n)
+{
+#ifdef TRAINER_X86
+	static const bool avx2 = Evaluator::HasAvx2();
+	if (avx2)
+		return DotAvx2(a, b, n);
+#endif
+	float sum = 0;
+	for (int i = 0; i < n; i++)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+static float Clip(float value)
+{
+	return max(0.0f, min(1.0f, value));
+}
+
+ValueNetwork::ValueNetwork()
+{
+	params.assign(SIZE, 0);
+}
+
+// uniform weights scaled by the size of each layer, the hidden biases start in the middle of the clipped range
+void ValueNetwork::Init(mt19937& random)
+{
+	params.assign(SIZE, 0);
+	int starts[3] = { W1, W2, W3 };
+	int sizes[3] = { CELLS * HIDDEN1, HIDDEN2 * HIDDEN1, HIDDEN2 };
+	int fans[3] = { CELLS + HIDDEN1, HIDDEN1 + HIDDEN2, HIDDEN2 + 1 };
+	for (int layer = 0; layer < 3; layer++)
+	{
+		float limit = sqrtf(6.0f / fans[layer]);
+		uniform_real_distribution<float> weight(-limit, limit);
+		for (int i = 0; i < sizes[layer]; i++)
+			params[starts[layer] + i] = weight(random);
+	}
+	for (int i = 0; i < HIDDEN1; i++)
+		params[B1 + i] = 0.5f;
+	for (int i = 0; i < HIDDEN2; i++)
+		params[B2 + i] = 0.5f;
+}
+
+// same function as NeuralEvaluator before quantizing: two hidden layers clipped to 0 .. 1 and a linear output
+float ValueNetwork::Forward(const unsigned short* cells, int cellNum, Activations& act) const
+{
+	const float* p = params.data();
+	for (int i = 0; i < HIDDEN1; i++)
+		act.pre1[i] = p[B1 + i];
+	for (int c = 0; c < cellNum; c++)
+		Axpy(1, p + W1 + cells[c] * HIDDEN1, act.pre1, HIDDEN1);
+	for (int i = 0; i < HIDDEN1; i++)
+		act.hidden1[i] = Clip(act.pre1[i]);
+	for (int o = 0; o < HIDDEN2; o++)
+	{
+		act.pre2[o] = p[B2 + o] + Dot(p + W2 + o * HIDDEN1, act.hidden1, HIDDEN1);
+		act.hidden2[o] = Clip(act.pre2[o]);
+	}
+	return p[B3] + Dot(p + W3, act.hidden2, HIDDEN2);
+}
+
+// add the gradient of gradOut times the output to grad, a clipped unit passes no gradient
+void ValueNetwork::Backward(const unsigned short* cells, int cellNum, const Activations& act, float gradOut, float* grad) const
+{
+	const float* p = params.data();
+	grad[B3] += gradOut;
+	Axpy(gradOut, act.hidden2, grad + W3, HIDDEN2);
+	alignas(32) float back1[HIDDEN1] = {};
+	for (int o = 0; o < HIDDEN2; o++)
+	{
+		if (act.pre2[o] <= 0 || act.pre2[o] >= 1)
+			continue;
+		float back2 = gradOut * p[W3 + o];
+		grad[B2 + o] += back2;
+		Axpy(back2, act.hidden1, grad + W2 + o * HIDDEN1, HIDDEN1);
+		Axpy(back2, p + W2 + o * HIDDEN1, back1, HIDDEN1);
+	}
+	for (int i = 0; i < HIDDEN1; i++)
+		if (act.pre1[i] <= 0 || act.pre1[i] >= 1)
+			back1[i] = 0;
+	Axpy(1, back1, grad + B1, HIDDEN1);
+	for (int c = 0; c < cellNum; c++)
+		Axpy(1, back1, grad + W1 + cells[c] * HIDDEN1, HIDDEN1);
+}
+
+// the first layer goes back to a row per output over the whole input, the padding inputs get 0
+void ValueNetwork::Export(NeuralEvaluator& network) const
+{
+	const int input = NeuralEvaluator::INPUT;
+	vector<float> w1(HIDDEN1 * input, 0);
+	for (int c = 0; c < CELLS; c++)
+		for (int o = 0; o < HIDDEN1; o++)
+			w1[o * input + c] = params[W1 + c * HIDDEN1 + o];
+	network.Quantize(w1.data(), &params[B1], &params[W2], &params[B2], &params[W3], params[B3]);
+}
+
+// inputs of the filled cells in the order of NeuralEvaluator::Encode, return how many
+int ValueNetwork::Cells(const unsigned short* rows, unsigned short* cells)
+{
+	int cellNum = 0;
+	for (int y = 0; y < NeuralEvaluator::ROWS; y++)
+		for (RowMask row = rows[y]; row; row &= row - 1)
+			cells[cellNum++] = (unsigned short)(y * NeuralEvaluator::COLUMNS + LowestBit(row));
+	return cellNum;
+}
+
+// playfield columns as bits 0 .. 9, top row first, how boards are kept in the replay buffer
+void ValueNetwork::Rows(const BitBoard& board, unsigned short* rows)
+{
+	for (int y = 0; y < NeuralEvaluator::ROWS; y++)
+		rows[y] = (unsigned short)((board.rows[y] & BitBoard::FIELD) >> (BitBoard::PAD + 1));
+}
+
+ValueTrainer::ValueTrainer(unsigned int seed) : random(seed)
+{
+	network.Init(random);
+	target = network;
+	moment1.assign(ValueNetwork::SIZE, 0);
+	moment2.assign(ValueNetwork::SIZE, 0);
+	grads.assign(max(1, min(pool.Size(), BATCH)), vector<float>(ValueNetwork::SIZE, 0));
+	replay.resize(REPLAY_SIZE);
+	replayNum = 0;
+	environments.resize(ENVIRONMENTS);
+	for (int i = 0; i < ENVIRONMENTS; i++)
+	{
+		environments[i].random.seed(seed * ENVIRONMENTS + i);
+		environments[i].game.Reset(environments[i].random());
+	}
+	steps = 0;
+	updates = 0;
+	lineReward = EvalWeights().weight[BoardFeatures::LINES];
+	recentGames = 0;
+	recentLines = 0;
+	recentLoss = 0;
+	recentUpdates = 0;
+}
+
+// train for minutes, or until killed if 0, saving the quantized network to path and the float weights to path.train
+void ValueTrainer::Run(const string& path, int minutes)
+{
+	string checkpoint = path + ".train";
+	if (LoadCheckpoint(checkpoint))
+		cout << "Resumed " << checkpoint << " at step " << steps << endl;
+	cout << "Training on " << pool.Size() << " threads, " << ENVIRONMENTS << " games at once" << endl;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chrono::steady_clock::time_point lastProgress = start;
+	chrono::steady_clock::time_point lastSave = start;
+	long long startSteps = steps;
+	bool running = true;
+	while (running)
+	{
+		StepEnvironments();
+		// two samples trained per placement played
+		if (min(replayNum, (long long)REPLAY_SIZE) >= REPLAY_START)
+		{
+			recentLoss += Update();
+			recentUpdates += 1;
+		}
+
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		running = minutes == 0 || now - start < chrono::minutes(minutes);
+		if (now - lastProgress >= chrono::seconds(PROGRESS_SECONDS) || !running)
+		{
+			double seconds = chrono::duration<double>(now - start).count();
+			printf("step %lld  %.0f steps/s  %lld games  %.1f lines/game  loss %.4f  epsilon %.3f\n",
+				steps, (steps - startSteps) / seconds, recentGames, recentGames ? (double)recentLines / recentGames : 0.0,
+				recentUpdates ? recentLoss / recentUpdates : 0.0, Epsilon());
+			fflush(stdout);
+			recentGames = 0;
+			recentLines = 0;
+			recentLoss = 0;
+			recentUpdates = 0;
+			lastProgress = now;
+		}
+		if (now - lastSave >= chrono::seconds(SAVE_SECONDS) || !running)
+		{
+			NeuralEvaluator quantized;
+			network.Export(quantized);
+			if (!quantized.Save(path) || !SaveCheckpoint(checkpoint))
+				cout << "Failed to save " << path << endl;
+			lastSave = now;
+		}
+	}
+}
+
+// one placement in every game on the pool, then their transitions go to the buffer in order
+void ValueTrainer::StepEnvironments()
+{
+	float epsilon = Epsilon();
+	pool.ParallelFor(ENVIRONMENTS, [this, epsilon](int i) { Step(environments[i], epsilon); });
+	for (Environment& env : environments)
+	{
+		if (env.hasTransition)
+		{
+			replay[replayNum % REPLAY_SIZE] = env.transition;
+			replayNum += 1;
+			env.hasTransition = false;
+		}
+		if (env.finishedLines >= 0)
+		{
+			recentGames += 1;
+			recentLines += env.finishedLines;
+			env.finishedLines = -1;
+		}
+	}
+	steps += ENVIRONMENTS;
+}
+
+// the best placement by lines and value of the board it leaves, or a random one with probability epsilon
+void ValueTrainer::Step(Environment& env, float epsilon)
+{
+	HeadlessGame& game = env.game;
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	int count = MoveGen::Generate(game.board, game.currType, placements);
+	if (count > 0)
+	{
+		int choice = 0;
+		if (uniform_real_distribution<float>(0, 1)(env.random) < epsilon)
+			choice = uniform_int_distribution<int>(0, count - 1)(env.random);
+		else
+		{
+			ValueNetwork::Activations act;
+			unsigned short rows[NeuralEvaluator::ROWS];
+			unsigned short cells[ValueNetwork::CELLS];
+			float best = 0;
+			for (int i = 0; i < count; i++)
+			{
+				BitBoard board = game.board;
+				int lines = board.Place(game.currType, placements[i]);
+				float value = lines * lineReward;
+				if (!board.IsGameOver())
+				{
+					ValueNetwork::Rows(board, rows);
+					value += network.Forward(cells, ValueNetwork::Cells(rows, cells), act);
+				}
+				if (i == 0 || value > best)
+				{
+					best = value;
+					choice = i;
+				}
+			}
+		}
+		float reward = game.Step(placements[choice]) * lineReward;
+		unsigned short rows[NeuralEvaluator::ROWS];
+		ValueNetwork::Rows(game.board, rows);
+		if (env.hasPrev)
+		{
+			copy(env.prevRows, env.prevRows + NeuralEvaluator::ROWS, env.transition.rows);
+			copy(rows, rows + NeuralEvaluator::ROWS, env.transition.nextRows);
+			env.transition.reward = reward;
+			env.transition.terminal = game.gameOver ? 1 : 0;
+			env.hasTransition = true;
+		}
+		copy(rows, rows + NeuralEvaluator::ROWS, env.prevRows);
+		env.hasPrev = true;
+	}
+	else if (env.hasPrev)
+	{
+		// nowhere to place the piece, the last board lost
+		copy(env.prevRows, env.prevRows + NeuralEvaluator::ROWS, env.transition.rows);
+		copy(env.prevRows, env.prevRows + NeuralEvaluator::ROWS, env.transition.nextRows);
+		env.transition.reward = 0;
+		env.transition.terminal = 1;
+		env.hasTransition = true;
+	}
+
+	if (count == 0 || game.gameOver || game.pieces >= MAX_PIECES)
+	{
+		env.finishedLines = game.clearLinesNum;
+		game.Reset(env.random());
+		env.hasPrev = false;
+	}
+}
+
+// one Adam step on a minibatch with the Huber loss against the target network, return the mean loss
+float ValueTrainer::Update()
+{
+	int size = (int)min(replayNum, (long long)REPLAY_SIZE);
+	int samples[BATCH];
+	for (int i = 0; i < BATCH; i++)
+		samples[i] = uniform_int_distribution<int>(0, size - 1)(random);
+
+	int taskNum = (int)grads.size();
+	vector<float> losses(taskNum, 0);
+	pool.ParallelFor(taskNum, [&](int task) {
+		vector<float>& grad = grads[task];
+		fill(grad.begin(), grad.end(), 0.0f);
+		ValueNetwork::Activations act;
+		ValueNetwork::Activations nextAct;
+		unsigned short cells[ValueNetwork::CELLS];
+		for (int i = task; i < BATCH; i += taskNum)
+		{
+			const Transition& transition = replay[samples[i]];
+			float expected = transition.reward;
+			if (!transition.terminal)
+			{
+				int nextNum = ValueNetwork::Cells(transition.nextRows, cells);
+				expected += GAMMA * target.Forward(cells, nextNum, nextAct);
+			}
+			int cellNum = ValueNetwork::Cells(transition.rows, cells);
+			float error = network.Forward(cells, cellNum, act) - expected;
+			float clipped = max(-1.0f, min(1.0f, error));
+			losses[task] += fabsf(error) <= 1 ? 0.5f * error * error : fabsf(error) - 0.5f;
+			network.Backward(cells, cellNum, act, clipped / BATCH, grad.data());
+		}
+	});
+
+	vector<float>& grad = grads[0];
+	for (int task = 1; task < taskNum; task++)
+		Axpy(1, grads[task].data(), grad.data(), ValueNetwork::SIZE);
+	updates += 1;
+	float rate = LEARNING_RATE * sqrtf(1 - powf(BETA2, (float)updates)) / (1 - powf(BETA1, (float)updates));
+	for (int i = 0; i < ValueNetwork::SIZE; i++)
+	{
+		moment1[i] = BETA1 * moment1[i] + (1 - BETA1) * grad[i];
+		moment2[i] = BETA2 * moment2[i] + (1 - BETA2) * grad[i] * grad[i];
+		network.params[i] -= rate * moment1[i] / (sqrtf(moment2[i]) + ADAM_EPSILON);
+	}
+	if (updates % TARGET_UPDATES == 0)
+		target = network;
+
+	float loss = 0;
+	for (float value : losses)
+		loss += value;
+	return loss / BATCH;
+}
+
+// falls linearly over EPSILON_STEPS placements
+float ValueTrainer::Epsilon() const
+{
+	float done = min(1.0f, (float)steps / EPSILON_STEPS);
+	return EPSILON_START + (EPSILON_END - EPSILON_START) * done;
+}
+
+// MAGIC, SIZE, steps and updates, then the params and both Adam moments, the replay buffer refills after a resume
+bool ValueTrainer::LoadCheckpoint(const string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return false;
+	unsigned int header[2];
+	long long counts[2];
+	vector<float> params(ValueNetwork::SIZE), first(ValueNetwork::SIZE), second(ValueNetwork::SIZE);
+	bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == MAGIC && header[1] == ValueNetwork::SIZE
+		&& fread(counts, sizeof(counts), 1, file) == 1
+		&& fread(params.data(), sizeof(float), params.size(), file) == params.size()
+		&& fread(first.data(), sizeof(float), first.size(), file) == first.size()
+		&& fread(second.data(), sizeof(float), second.size(), file) == second.size();
+	fclose(file);
+	if (!ok)
+		return false;
+	steps = counts[0];
+	updates = counts[1];
+	network.params = params;
+	target = network;
+	moment1 = first;
+	moment2 = second;
+	return true;
+}
+
+// temp takes the place of path in one step, so there is no moment without a checkpoint at path
+static bool ReplaceFile(const string& temp, const string& path)
+{
+#ifdef _WIN32
+	// rename doesn't replace an existing file on Windows
+	return MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(temp.c_str(), path.c_str()) == 0;
+#endif
+}
+
+bool ValueTrainer::SaveCheckpoint(const string& path) const
+{
+	string temp = path + ".tmp";
+	FILE* file = fopen(temp.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	unsigned int header[2] = { MAGIC, (unsigned int)ValueNetwork::SIZE };
+	long long counts[2] = { steps, updates };
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1
+		&& fwrite(counts, sizeof(counts), 1, file) == 1
+		&& fwrite(network.params.data(), sizeof(float), network.params.size(), file) == network.params.size()
+		&& fwrite(moment1.data(), sizeof(float), moment1.size(), file) == moment1.size()
+		&& fwrite(moment2.data(), sizeof(float), moment2.size(), file) == moment2.size();
+	if (fclose(file) != 0 || !ok)
+		return false;
+	return ReplaceFile(temp, path);
+}
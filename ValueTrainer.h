@@ -0,0 +1,119 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <random>
+#include "NeuralEvaluator.h"
+#include "HeadlessGame.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// float copy of the NeuralEvaluator layers for training
+// the first layer has one row per board cell, so a board only reads and updates the rows of its filled cells
+struct ValueNetwork
+{
+	static const int CELLS = NeuralEvaluator::CELLS;
+	static const int HIDDEN1 = NeuralEvaluator::HIDDEN1;
+	static const int HIDDEN2 = NeuralEvaluator::HIDDEN2;
+	// offsets of the layers in params, every row starts on a whole 8 floats
+	static const int W1 = 0;
+	static const int B1 = W1 + CELLS * HIDDEN1;
+	static const int W2 = B1 + HIDDEN1;
+	static const int B2 = W2 + HIDDEN2 * HIDDEN1;
+	static const int W3 = B2 + HIDDEN2;
+	static const int B3 = W3 + HIDDEN2;
+	static const int SIZE = B3 + 8;
+	struct Activations
+	{
+		alignas(32) float pre1[HIDDEN1];
+		alignas(32) float hidden1[HIDDEN1];
+		alignas(32) float pre2[HIDDEN2];
+		alignas(32) float hidden2[HIDDEN2];
+	};
+	vector<float> params;
+	ValueNetwork();
+	void Init(mt19937& random);
+	float Forward(const unsigned short* cells, int cellNum, Activations& act) const;
+	void Backward(const unsigned short* cells, int cellNum, const Activations& act, float gradOut, float* grad) const;
+	void Export(NeuralEvaluator& network) const;
+	static int Cells(const unsigned short* rows, unsigned short* cells);
+	static void Rows(const BitBoard& board, unsigned short* rows);
+};
+
+// learns the value of the board after a placement by TD(0) on afterstates, the way Evaluator uses the network:
+// a placement is worth its lines times the LINES weight plus the value of the board it leaves
+// environments step on the pool with epsilon greedy play, transitions go to a replay buffer sampled in minibatches,
+// and the targets come from a copy of the network refreshed every TARGET_UPDATES updates
+class ValueTrainer
+{
+public:
+	static const int ENVIRONMENTS = 32;
+	// transitions kept, the oldest are overwritten
+	static const int REPLAY_SIZE = 1 << 18;
+	// updates start once the buffer holds this many
+	static const int REPLAY_START = 10000;
+	static const int BATCH = 64;
+	static const int TARGET_UPDATES = 2000;
+	// a game is cut here and restarted, its last board is not treated as lost
+	static const int MAX_PIECES = 5000;
+	static const int EPSILON_STEPS = 500000;
+	static const int SAVE_SECONDS = 300;
+	static const int PROGRESS_SECONDS = 10;
+	// "TVT1" at the start of a training checkpoint
+	static const unsigned int MAGIC = 0x31545654;
+	static const float GAMMA;
+	static const float LEARNING_RATE;
+	static const float EPSILON_START;
+	static const float EPSILON_END;
+private:
+	struct Transition
+	{
+		unsigned short rows[NeuralEvaluator::ROWS];
+		unsigned short nextRows[NeuralEvaluator::ROWS];
+		float reward;
+		// the next board lost the game, its value is 0
+		int terminal;
+	};
+	struct Environment
+	{
+		HeadlessGame game;
+		mt19937 random;
+		bool hasPrev = false;
+		unsigned short prevRows[NeuralEvaluator::ROWS];
+		Transition transition;
+		bool hasTransition = false;
+		// lines of the game that just ended, -1 while it goes on
+		int finishedLines = -1;
+	};
+	ThreadPool pool;
+	ValueNetwork network;
+	ValueNetwork target;
+	// Adam moments, same layout as the params
+	vector<float> moment1;
+	vector<float> moment2;
+	// one gradient per pool task, summed after the minibatch
+	vector<vector<float>> grads;
+	vector<Transition> replay;
+	long long replayNum;
+	vector<Environment> environments;
+	mt19937 random;
+	unsigned int nextSeed;
+	long long steps;
+	long long updates;
+	float lineReward;
+	// lines of the games finished since the last progress line
+	long long recentGames;
+	long long recentLines;
+	double recentLoss;
+	long long recentUpdates;
+public:
+	ValueTrainer(unsigned int seed = 1);
+	void Run(const string& path, int minutes = 0);
+private:
+	void StepEnvironments();
+	void Step(Environment& env, float epsilon);
+	float Update();
+	float Epsilon() const;
+	bool LoadCheckpoint(const string& path);
+	bool SaveCheckpoint(const string& path) const;
+};
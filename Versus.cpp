@@ -0,0 +1,205 @@
+#include "Versus.h"
+#include "MoveGen.h"
+#include <algorithm>
+
+const int Versus::LINE_ATTACK[5] = { 0, 0, 1, 2, 4 };
+const int Versus::TSPIN_ATTACK[4] = { 0, 2, 4, 6 };
+const int Versus::COMBO_ATTACK[12] = { 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 4, 5 };
+const float Versus::ATTACK_WEIGHT = 1.5f;
+const float Versus::PENDING_WEIGHT = -0.5f;
+const float Versus::COMBO_WEIGHT = 0.5f;
+const float Versus::BACK_TO_BACK_WEIGHT = 1.0f;
+const float Versus::PRESSURE = 1.0f;
+const float Versus::KILL = 1e6f;
+
+// value of a placement that tops out
+static const float LOSS = -1e9f;
+
+Versus::Versus(ThreadPool* threadPool)
+{
+	pool = threadPool;
+}
+
+// the placement for the current piece, searched on the pool if there is one and cut at millisecond
+// placements are searched deeper best first by their own score, those the time didn't reach are left out
+bool Versus::Search(const HeadlessGame& game, const VersusState& state, const BitBoard& opponent, int opponentPending, int millisecond, Placement& best)
+{
+	deadline = chrono::steady_clock::now() + chrono::milliseconds(millisecond);
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	int count = MoveGen::Generate(game.board, game.currType, placements);
+	if (count == 0)
+		return false;
+
+	// garbage that tops the opponent out, and attacks count more the less room they have
+	int room = BitBoard::HEIGHT - 1 - Game::BUFFER_HEIGHT;
+	int kill = max(1, FreeRows(opponent) - opponentPending);
+	float attackWeight = ATTACK_WEIGHT * (1 + PRESSURE * (1 - (float)min(kill, room) / room));
+
+	after.resize(count);
+	states.assign(count, state);
+	lines.resize(count);
+	sent.resize(count);
+	lost.resize(count);
+	values.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		after[i] = game.board;
+		lines[i] = after[i].Place(game.currType, placements[i]);
+		VersusState& next = states[i];
+		sent[i] = Exchange(Attack(game.board, game.currType, placements[i], lines[i], after[i].IsPerfectClear(), next), next);
+		lost[i] = after[i].IsGameOver() || !Rise(after[i], lines[i], next);
+		values[i] = Value(after[i], lines[i], next, sent[i], kill, attackWeight, lost[i]);
+	}
+	order.resize(count);
+	for (int i = 0; i < count; i++)
+		order[i] = i;
+	sort(order.begin(), order.end(), [&](int a, int b) { return values[a] > values[b]; });
+
+	searched.assign(count, 0);
+	auto deeper = [&](int rank) {
+		int i = order[rank];
+		// the best placement is always searched, so there is a move even past the deadline
+		if (lost[i] || (rank > 0 && chrono::steady_clock::now() >= deadline))
+			return;
+		values[i] = BestNext(after[i], game.nextType, states[i], sent[i], kill, attackWeight);
+		searched[i] = 1;
+	};
+	if (pool)
+		pool->ParallelFor(count, deeper);
+	else
+		for (int rank = 0; rank < count; rank++)
+			deeper(rank);
+
+	int choice = order[0];
+	for (int i = 0; i < count; i++)
+		if (searched[i] && values[i] > values[choice])
+			choice = i;
+	best = placements[choice];
+	return true;
+}
+
+// a tucked T with three of the four corners around its center filled, walls and floor count as filled
+// MoveGen reaches tucks by sliding rather than rotating in, so the last move isn't checked
+bool Versus::IsTSpin(const BitBoard& board, int type, const Placement& move)
+{
+	if (type != T_TYPE || !move.tuck)
+		return false;
+	const RowMask* rows = BitBoard::PieceRows(type, move.rotation);
+	for (int y = 0; y < 4; y++)
+		for (int x = 0; x < 4; x++)
+		{
+			if (!(rows[y] >> x & 1))
+				continue;
+			// the center is the cell with a neighbour on three sides
+			int neighbours = (x > 0 && (rows[y] >> (x - 1) & 1)) + (x < 3 && (rows[y] >> (x + 1) & 1))
+				+ (y > 0 && (rows[y - 1] >> x & 1)) + (y < 3 && (rows[y + 1] >> x & 1));
+			if (neighbours != 3)
+				continue;
+			int corners = 0;
+			for (int dy = -1; dy <= 1; dy += 2)
+				for (int dx = -1; dx <= 1; dx += 2)
+				{
+					int cornerY = move.y + y + dy;
+					if (cornerY >= 0 && (board.rows[cornerY] >> (move.x + x + dx + BitBoard::PAD) & 1))
+						corners += 1;
+				}
+			return corners >= 3;
+		}
+	return false;
+}
+
+// garbage a placement on board sends before cancelling, state moves on to after the placement
+// a tetris or a T-spin clear after another one gets BACK_TO_BACK_ATTACK more, clears in a row add the combo
+int Versus::Attack(const BitBoard& board, int type, const Placement& move, int lines, bool perfectClear, VersusState& state)
+{
+	if (lines == 0)
+	{
+		state.combo = 0;
+		return 0;
+	}
+	bool tSpin = IsTSpin(board, type, move);
+	bool difficult = lines == 4 || tSpin;
+	int attack = tSpin ? TSPIN_ATTACK[min(lines, 3)] : LINE_ATTACK[lines];
+	if (difficult && state.backToBack)
+		attack += BACK_TO_BACK_ATTACK;
+	state.backToBack = difficult;
+	state.combo += 1;
+	attack += COMBO_ATTACK[min(state.combo - 1, 11)];
+	if (perfectClear)
+		attack = max(attack, PERFECT_CLEAR_ATTACK);
+	return attack;
+}
+
+// cancel pending garbage with the attack, return the lines sent to the opponent
+int Versus::Exchange(int attack, VersusState& state)
+{
+	int cancelled = min(attack, state.pending);
+	state.pending -= cancelled;
+	return attack - cancelled;
+}
+
+// lines of garbage the board takes before its stack reaches the buffer rows
+int Versus::FreeRows(const BitBoard& board)
+{
+	for (int y = 0; y < BitBoard::HEIGHT - 1; y++)
+		if (board.rows[y] & BitBoard::FIELD)
+			return max(0, y - Game::BUFFER_HEIGHT);
+	return BitBoard::HEIGHT - 1 - Game::BUFFER_HEIGHT;
+}
+
+// column with the lowest top, leftmost on a tie
+int Versus::LowestColumn(const BitBoard& board)
+{
+	int lowest = 1;
+	int lowestTop = -1;
+	for (int x = 1; x < BitBoard::WIDTH - 1; x++)
+	{
+		int top = 0;
+		while (top < BitBoard::HEIGHT - 1 && !(board.rows[top] >> (x + BitBoard::PAD) & 1))
+			top += 1;
+		if (top > lowestTop)
+		{
+			lowest = x;
+			lowestTop = top;
+		}
+	}
+	return lowest;
+}
+
+// pending garbage rises after a piece that clears nothing, the search can't know the hole so it goes under the lowest column
+// false if the garbage tops the board out
+bool Versus::Rise(BitBoard& board, int lines, VersusState& state)
+{
+	if (lines > 0 || state.pending == 0)
+		return true;
+	bool fits = board.AddGarbage(state.pending, LowestColumn(board));
+	state.pending = 0;
+	return fits && !board.IsGameOver();
+}
+
+// best value over every placement of type after a root placement that sent sent
+float Versus::BestNext(const BitBoard& board, int type, const VersusState& state, int sent, int kill, float attackWeight) const
+{
+	Placement placements[MoveGen::MAX_PLACEMENTS];
+	int count = MoveGen::Generate(board, type, placements);
+	float best = LOSS;
+	for (int i = 0; i < count; i++)
+	{
+		BitBoard after = board;
+		int lines = after.Place(type, placements[i]);
+		VersusState next = state;
+		int total = sent + Exchange(Attack(board, type, placements[i], lines, after.IsPerfectClear(), next), next);
+		bool lost = after.IsGameOver() || !Rise(after, lines, next);
+		best = max(best, Value(after, lines, next, total, kill, attackWeight, lost));
+	}
+	return best;
+}
+
+float Versus::Value(const BitBoard& board, int lines, const VersusState& state, int sent, int kill, float attackWeight, bool lost) const
+{
+	if (lost)
+		return LOSS;
+	float value = Evaluator::Score(board, lines, weights) + attackWeight * sent + PENDING_WEIGHT * state.pending
+		+ COMBO_WEIGHT * state.combo + (state.backToBack ? BACK_TO_BACK_WEIGHT : 0);
+	return sent >= kill ? value + KILL : value;
+}
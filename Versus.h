@@ -0,0 +1,69 @@
+#pragma once
+#include <chrono>
+#include <vector>
+#include "Evaluator.h"
+#include "HeadlessGame.h"
+#include "ThreadPool.h"
+
+// what a versus player carries from one piece to the next besides the board
+struct VersusState
+{
+	// garbage lines sent by the opponent that haven't risen yet
+	int pending = 0;
+	// clearing pieces in a row, 0 after a piece that clears nothing
+	int combo = 0;
+	// the last clear was a tetris or a T-spin
+	bool backToBack = false;
+};
+
+// garbage rules of versus play and a search that plays them
+// an attack first cancels the player's own pending garbage, the rest is sent; pending garbage rises after a piece that clears nothing
+// the search tries every placement of the current and the next piece, scoring the boards with the pending garbage risen,
+// the garbage sent weighted up as the opponent's stack gets higher, and the combo and back to back kept
+class Versus
+{
+public:
+	// garbage for clearing 0 .. 4 lines at once
+	static const int LINE_ATTACK[5];
+	// garbage for a T-spin clearing 0 .. 3 lines
+	static const int TSPIN_ATTACK[4];
+	// extra garbage by combo, the last entry for every longer combo
+	static const int COMBO_ATTACK[12];
+	static const int BACK_TO_BACK_ATTACK = 1;
+	static const int PERFECT_CLEAR_ATTACK = 10;
+	static const int T_TYPE = 5;
+	// one frame at 60 frames per second
+	static const int FRAME_MILLISECOND = 16;
+	static const float ATTACK_WEIGHT;
+	static const float PENDING_WEIGHT;
+	static const float COMBO_WEIGHT;
+	static const float BACK_TO_BACK_WEIGHT;
+	// how much more an attack is worth against a full opponent stack than an empty one
+	static const float PRESSURE;
+	static const float KILL;
+	EvalWeights weights;
+private:
+	ThreadPool* pool;
+	chrono::steady_clock::time_point deadline;
+	// per placement of the current piece, kept across searches so a game allocates them once
+	vector<BitBoard> after;
+	vector<VersusState> states;
+	vector<int> lines;
+	vector<int> sent;
+	vector<char> lost;
+	vector<float> values;
+	vector<int> order;
+	vector<char> searched;
+public:
+	Versus(ThreadPool* threadPool = nullptr);
+	bool Search(const HeadlessGame& game, const VersusState& state, const BitBoard& opponent, int opponentPending, int millisecond, Placement& best);
+	static bool IsTSpin(const BitBoard& board, int type, const Placement& move);
+	static int Attack(const BitBoard& board, int type, const Placement& move, int lines, bool perfectClear, VersusState& state);
+	static int Exchange(int attack, VersusState& state);
+	static int FreeRows(const BitBoard& board);
+	static int LowestColumn(const BitBoard& board);
+private:
+	static bool Rise(BitBoard& board, int lines, VersusState& state);
+	float BestNext(const BitBoard& board, int type, const VersusState& state, int sent, int kill, float attackWeight) const;
+	float Value(const BitBoard& board, int lines, const VersusState& state, int sent, int kill, float attackWeight, bool lost) const;
+};
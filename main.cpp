@@ -1,13 +1,122 @@
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 #include "Game.h"
+#include "Tuner.h"
+#include "Arena.h"
+#include "OpeningBook.h"
+#include "SelfPlay.h"
+#include "ValueTrainer.h"
 
 using namespace std;
 
 int main(int argc, char* args[])
 {
+    // --tune file evolves the evaluation weights without a window, resuming from and saving to the checkpoint file
+    for (int i = 1; i < argc; i++)
+        if (strcmp(args[i], "--tune") == 0 && i + 1 < argc)
+        {
+            Tuner tuner;
+            tuner.Run(args[i + 1]);
+            return 0;
+        }
+
+    // --arena file [race|garbage] [games] rates the default bots and every --player checkpoint against each other
+    for (int i = 1; i < argc; i++)
+        if (strcmp(args[i], "--arena") == 0 && i + 1 < argc)
+        {
+            Arena arena;
+            ArenaPlayer player;
+            player.name = "default";
+            arena.AddPlayer(player);
+            player.name = "default lookahead";
+            player.lookahead = 1;
+            arena.AddPlayer(player);
+            player.name = "versus";
+            player.lookahead = 0;
+            player.versus = true;
+            arena.AddPlayer(player);
+            player.name = "mcts";
+            player.versus = false;
+            player.mcts = true;
+            arena.AddPlayer(player);
+            for (int j = 1; j + 1 < argc; j++)
+                if (strcmp(args[j], "--player") == 0)
+                {
+                    ArenaPlayer tuned;
+                    tuned.name = args[j + 1];
+                    if (Tuner::LoadBest(tuned.name, tuned.weights))
+                        arena.AddPlayer(tuned);
+                    else
+                        cout << "Failed to load " << tuned.name << endl;
+                }
+            int mode = i + 2 < argc && strcmp(args[i + 2], "garbage") == 0 ? Arena::GARBAGE : Arena::RACE;
+            int games = i + 3 < argc ? max(1, atoi(args[i + 3])) : 100;
+            arena.Run(args[i + 1], mode, games);
+            return 0;
+        }
+
+    // --train file [minutes] learns a network for --network by self-play, resuming from file.train when it exists
+    for (int i = 1; i < argc; i++)
+        if (strcmp(args[i], "--train") == 0 && i + 1 < argc)
+        {
+            ValueTrainer trainer;
+            trainer.Run(args[i + 1], i + 2 < argc ? max(0, atoi(args[i + 2])) : 0);
+            return 0;
+        }
+
+    // --selfplay file [games] appends every placement of games played on all cores, with --player checkpoint playing the tuned weights
+    for (int i = 1; i < argc; i++)
+        if (strcmp(args[i], "--selfplay") == 0 && i + 1 < argc)
+        {
+            SelfPlay selfPlay;
+            ArenaPlayer player;
+            for (int j = 1; j + 1 < argc; j++)
+                if (strcmp(args[j], "--player") == 0 && !Tuner::LoadBest(args[j + 1], player.weights))
+                    cout << "Failed to load " << args[j + 1] << endl;
+            selfPlay.SetPlayer(player);
+            int games = i + 2 < argc ? max(1, atoi(args[i + 2])) : 1000;
+            if (!selfPlay.Run(args[i + 1], games))
+                cout << "Failed to write " << args[i + 1] << endl;
+            return 0;
+        }
+
+    // --build-book file [ms] searches the first bag moves of every order and writes the book
+    for (int i = 1; i < argc; i++)
+        if (strcmp(args[i], "--build-book") == 0 && i + 1 < argc)
+        {
+            int millisecond = i + 2 < argc ? max(1, atoi(args[i + 2])) : OpeningBook::DEFAULT_MILLISECOND;
+            if (!OpeningBook::Build(args[i + 1], millisecond))
+                cout << "Failed to build " << args[i + 1] << endl;
+            return 0;
+        }
+
     cout << "Welcome to tetris" << endl;
 
-    Game game;
+    // --terminal plays in the console with ANSI escape codes and no window, audio or font, keys are read from stdin,
+    // so a session can be played or watched with --autoplay over ssh
+    bool terminalOnly = false;
+    for (int i = 1; i < argc; i++)
+        if (strcmp(args[i], "--terminal") == 0)
+            terminalOnly = true;
+    Game game(terminalOnly);
+
+    // --autoplay lets the bot play, A toggles it in game
+    // --network file scores the bot's boards with a NeuralEvaluator weight file
+    // --book file plays the first bag from an opening book
+    // --level n sets the autoplay strength from 0 to 9, lower levels think less, press fewer keys and make mistakes
+    for (int i = 1; i < argc; i++)
+        if (strcmp(args[i], "--network") == 0 && i + 1 < argc)
+            game.SetNetwork(args[++i]);
+        else if (strcmp(args[i], "--level") == 0 && i + 1 < argc)
+            game.SetBotLevel(atoi(args[++i]));
+        else if (strcmp(args[i], "--book") == 0 && i + 1 < argc)
+        {
+            if (!game.SetBook(args[++i]))
+                cout << "Failed to load book " << args[i] << endl;
+        }
+        else if (strcmp(args[i], "--autoplay") == 0)
+            game.SetAutoplay(true);
 
     if (game.InitSuccess())
         game.StartGame();